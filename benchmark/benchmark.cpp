@@ -1,108 +1,511 @@
 #include <cctype>
+#include <cmath>
 #include <algorithm>
 #include <iostream>
 #include <chrono>
-#include <format>
 #include <random>
+#include <fstream>
+#include <filesystem>
+#include <functional>
+#include <numeric>
+#include <string>
+#include <vector>
 
 #include "../include/radix_sort.hpp"
 
-template<typename p1, typename p2, typename Op>
-void test_pair(size_t test_size, size_t test_round, Op op, std::string sort_name)
+//usage: benchmark [--sizes=1e6,1e7] [--rounds=5] [--filter=text] [--max-bytes=n] [--csv=path] [--json=path] [--tuning] [--external]
+//every case runs on a copy of the same generated input, the copy is not timed. results are printed as one line per case
+//and written as CSV or JSON with the median and percentiles of ns per element, so runs can be compared across releases
+
+//key of size bytes followed by a payload, sorted by key only
+template <size_t bytes>
+struct record
+{
+	std::uint64_t key;
+	unsigned char payload[bytes - sizeof(std::uint64_t)];
+};
+
+template <size_t bytes>
+struct radix_trait<record<bytes>> : radix_key_trait<record<bytes>, radix_field<&record<bytes>::key>>
+{
+};
+
+template <typename T>
+std::string type_name()
 {
 	using namespace std;
-	uniform_int_distribution<p1> rnd1;
-	uniform_int_distribution<p2> rnd2;
-	int used_time = 0;
-	vector<pair<p1, p2>> ar;
-	ar.resize(test_size + 1);
-	for (int i = 0; i < test_round; ++i)
+	if constexpr (is_pointer_v<T>)
+		return "pointer";
+	else if constexpr (is_floating_point_v<T>)
+		return sizeof(T) == 4 ? "float" : "double";
+	else if constexpr (is_integral_v<T>)
+		return (is_signed_v<T> ? "int" : "uint") + to_string(sizeof(T) * CHAR_BIT);
+	else
+		return "record" + to_string(sizeof(T));
+}
+
+//the order radix_trait<T> sorts in, as a comparison std::sort can use: floats by their bits, so NaNs have a place too
+template <typename T>
+struct bench_less
+{
+	static auto key(const T& x) noexcept
 	{
+		if constexpr (std::is_floating_point_v<T>)
 		{
-			minstd_rand e(114514);
-			for (int i = 0; i < test_size; ++i)
-				ar[i] = { rnd1(e),rnd2(e) };
+			using bits_type = std::conditional_t<sizeof(T) == 4, std::uint32_t, std::uint64_t>;
+			auto bits = std::bit_cast<bits_type>(x);
+			constexpr auto sign = bits_type(1) << (sizeof(T) * CHAR_BIT - 1);
+			return bits & sign ? bits_type(~bits) : bits_type(bits | sign);
 		}
-		auto beg = chrono::high_resolution_clock::now();
-		op(ar.begin(), ar.end());
-		used_time += (chrono::high_resolution_clock::now() - beg) / 1ms;
+		else if constexpr (std::is_pointer_v<T> || std::is_arithmetic_v<T>)
+			return x;
+		else
+			return x.key;
 	}
-	cout << sort_name << " used time(" << test_size << " " << typeid(pair<p1, p2>{}).name() << "):" << used_time / test_round << "ms\n";
+	bool operator()(const T& a, const T& b) const noexcept
+	{
+		return key(a) < key(b);
+	}
+};
+
+inline std::uint64_t splitmix64(std::uint64_t x) noexcept
+{
+	x += 0x9e3779b97f4a7c15ull;
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+	return x ^ (x >> 31);
+}
+
+//pointers point into this block, so that they are real addresses of one allocation
+inline char* pointer_pool()
+{
+	static std::vector<char> pool(size_t(1) << 24);
+	return pool.data();
 }
 
-template<typename T, typename Op>
-void test(size_t test_size, size_t test_round, Op op, std::string sort_name)
+//the element of type T made from 64 random bits: floats get both signs, records a payload
+template <typename T>
+T make_value(std::uint64_t raw)
 {
 	using namespace std;
-	uniform_int_distribution<T> rnd;
-	int used_time = 0;
-	vector<T> ar;
-	ar.resize(test_size + 1);
-	for (int i = 0; i < test_round; ++i)
+	if constexpr (is_pointer_v<T>)
+		return pointer_pool() + raw % (size_t(1) << 24);
+	else if constexpr (is_floating_point_v<T>)
+		return static_cast<T>(static_cast<double>(static_cast<int64_t>(raw)) * 0x1p-40);
+	else if constexpr (is_arithmetic_v<T>)
+		return static_cast<T>(raw);
+	else
 	{
+		T obj;
+		obj.key = raw;
+		memset(obj.payload, static_cast<int>(raw), sizeof(obj.payload));
+		return obj;
+	}
+}
+
+const std::vector<std::string> distributions = { "uniform", "sorted", "reverse", "all_equal", "few_unique", "zipf", "small_range", "nan" };
+
+template <typename T>
+bool applicable(const std::string& distribution)
+{
+	return distribution != "nan" || std::is_floating_point_v<T>;
+}
+
+//input of length n drawn from distribution, the same for every algorithm
+template <typename T>
+std::vector<T> make_input(const std::string& distribution, size_t n)
+{
+	using namespace std;
+	mt19937_64 e(114514);
+	vector<T> ar(n);
+	if (distribution == "few_unique")
+	{
+		array<uint64_t, 16> unique;
+		for (auto& x : unique)
+			x = e();
+		for (auto& x : ar)
+			x = make_value<T>(unique[e() % unique.size()]);
+	}
+	else if (distribution == "zipf")
+	{
+		//rank r is drawn with probability proportional to 1/r, every rank has a random value
+		constexpr size_t rank_num = 1 << 20;
+		vector<double> cdf(rank_num);
+		double sum = 0;
+		for (size_t r = 0; r < rank_num; ++r)
+			cdf[r] = sum += 1.0 / (r + 1);
+		uniform_real_distribution<double> rnd(0, sum);
+		for (auto& x : ar)
+			x = make_value<T>(splitmix64(lower_bound(cdf.begin(), cdf.end(), rnd(e)) - cdf.begin()));
+	}
+	else if (distribution == "small_range")
+	{
+		//values below 256 in a wide type, so most digits are the same everywhere
+		for (auto& x : ar)
+			if constexpr (is_floating_point_v<T>)
+				x = static_cast<T>(e() % 256);
+			else
+				x = make_value<T>(e() % 256);
+	}
+	else if (distribution == "all_equal")
+		fill(ar.begin(), ar.end(), make_value<T>(e()));
+	else
+	{
+		for (auto& x : ar)
+			x = make_value<T>(e());
+		if constexpr (is_floating_point_v<T>)
+			if (distribution == "nan")
+			{
+				//one element in a hundred is a NaN of either sign
+				for (auto& x : ar)
+					if (e() % 100 == 0)
+						x = e() % 2 ? numeric_limits<T>::quiet_NaN() : -numeric_limits<T>::quiet_NaN();
+			}
+		if (distribution == "sorted" || distribution == "reverse")
 		{
-			minstd_rand e(114514);
-			for (int i = 0; i < test_size; ++i)
-				ar[i] = rnd(e);
+			sort(ar.begin(), ar.end(), bench_less<T>{});
+			if (distribution == "reverse")
+				reverse(ar.begin(), ar.end());
 		}
-		auto beg = chrono::high_resolution_clock::now();
-		op(ar.begin(), ar.end());
-		used_time += (chrono::high_resolution_clock::now() - beg) / 1ms;
 	}
-	cout << sort_name << " used time(" << test_size << " " << typeid(T{}).name() << "):" << used_time / test_round << "ms\n";
+	return ar;
 }
 
-template<typename p1, typename p2>
-struct one_key
+struct bench_options
 {
-	static constexpr std::size_t radix_size = sizeof(p1) / sizeof(unsigned char);
-	template <size_t index>
-	static unsigned char get(const std::pair<p1, p2>& obj) noexcept
+	std::vector<size_t> sizes = { 10000, 1000000, 10000000, 100000000 };
+	size_t rounds = 5;
+	size_t max_bytes = size_t(1) << 31; //inputs larger than this are skipped
+	std::string filter;
+	std::string csv_path, json_path;
+	bool tuning = false, external = false;
+};
+
+struct bench_result
+{
+	std::string algorithm, type, distribution;
+	size_t size, element_bytes;
+	unsigned int threads;
+	std::vector<double> ns; //of every round, sorted
+	double percentile(double p) const
+	{
+		auto pos = p * (ns.size() - 1);
+		auto lo = static_cast<size_t>(pos);
+		return lo + 1 < ns.size() ? ns[lo] + (ns[lo + 1] - ns[lo]) * (pos - lo) : ns[lo];
+	}
+	double ns_per_element(double p) const
+	{
+		return percentile(p) / std::max<size_t>(size, 1);
+	}
+	double gb_per_s() const
 	{
-		static_assert(index < radix_size);
-		return radix_trait<p1>::get<index>(obj.first);
+		return size * element_bytes / percentile(0.5);
 	}
 };
 
-int main()
+std::vector<bench_result> results;
+size_t unsorted_cases = 0;
+
+template <typename T>
+struct bench_algorithm
+{
+	std::string name;
+	unsigned int threads;
+	std::function<void(T*, T*)> sort;
+	size_t run_length = 0; //the output is sorted in runs of this length, 0 for one run
+};
+
+//time every algorithm on copies of input, short inputs get more rounds so that each case runs about as long.
+//the output of the first round is checked, a case that does not sort its runs is reported and left out of the results
+template <typename T>
+void run(const bench_options& opt, const std::string& distribution, const std::vector<T>& input, const std::vector<bench_algorithm<T>>& algorithms)
+{
+	using namespace std;
+	constexpr size_t round_length = 10000000; //elements sorted per case before the round count stops growing
+	auto rounds = max(opt.rounds, min<size_t>(1000, round_length / max<size_t>(input.size(), 1)));
+	vector<T> ar(input.size());
+	for (auto& algorithm : algorithms)
+	{
+		bench_result result{ algorithm.name, type_name<T>(), distribution, input.size(), sizeof(T), algorithm.threads, {} };
+		if (!opt.filter.empty() && (result.algorithm + " " + result.type + " " + result.distribution).find(opt.filter) == string::npos)
+			continue;
+		bool sorted = true;
+		for (size_t i = 0; i < rounds && sorted; ++i)
+		{
+			copy(input.begin(), input.end(), ar.begin());
+			auto beg = chrono::steady_clock::now();
+			algorithm.sort(ar.data(), ar.data() + ar.size());
+			result.ns.push_back(chrono::duration<double, nano>(chrono::steady_clock::now() - beg).count());
+			auto run_length = algorithm.run_length ? algorithm.run_length : max<size_t>(ar.size(), 1);
+			for (size_t pos = 0; i == 0 && sorted && pos < ar.size(); pos += run_length)
+				sorted = is_sorted(ar.begin() + pos, ar.begin() + min(pos + run_length, ar.size()), bench_less<T>{});
+		}
+		if (!sorted)
+		{
+			cerr << result.algorithm << " " << result.type << " " << result.distribution << " " << result.size << ": output is not sorted" << endl;
+			++unsorted_cases;
+			continue;
+		}
+		sort(result.ns.begin(), result.ns.end());
+		cout << result.algorithm << " " << result.type << " " << result.distribution << " " << result.size << ": "
+			<< result.ns_per_element(0.5) << " ns per element (p10 " << result.ns_per_element(0.1) << ", p90 " << result.ns_per_element(0.9) << "), "
+			<< result.gb_per_s() << " GB/s" << endl;
+		results.push_back(std::move(result));
+	}
+}
+
+template <typename T>
+std::vector<bench_algorithm<T>> standard_algorithms()
 {
 	using namespace std;
-	int test_round = 5;
-	for (auto test_size : { 1e6,1e7,1e8,1e9 })
+	auto thrd_num = radix_hardware_concurrency();
+	return {
+		{ "std::sort", 1, [](T* a, T* b) { sort(a, b, bench_less<T>{}); } },
+		{ "std::stable_sort", 1, [](T* a, T* b) { stable_sort(a, b, bench_less<T>{}); } },
+		{ "radix_sort", 1, [](T* a, T* b) { radix_sort(a, b); } },
+		{ "std::sort(par)", thrd_num, [](T* a, T* b) { sort(execution::par, a, b, bench_less<T>{}); } },
+		{ "radix_sort(par)", thrd_num, [](T* a, T* b) { radix_sort(a, b, execution::par); } },
+	};
+}
+
+//every distribution at every size against the standard library
+template <typename T>
+void bench_type(const bench_options& opt)
+{
+	for (auto size : opt.sizes)
 	{
-		test<int>(test_size, test_round, [](const auto& a, const auto& b) {sort(a, b); }, "std::sort");
-		test<int>(test_size, test_round, [](const auto& a, const auto& b) {stable_sort(a, b); }, "std::stable_sort");
-		test<int>(test_size, test_round, [](const auto& a, const auto& b) {radix_sort(a, b); }, "radix_sort");
+		if (size * sizeof(T) > opt.max_bytes)
+			continue;
+		for (auto& distribution : distributions)
+			if (applicable<T>(distribution))
+				run<T>(opt, distribution, make_input<T>(distribution, size), standard_algorithms<T>());
+	}
+}
 
-		test<int>(test_size, test_round, [](const auto& a, const auto& b) {sort(execution::par, a, b); }, "std::sort(par)");
-		test<int>(test_size, test_round, [](const auto& a, const auto& b) {stable_sort(execution::par, a, b); }, "std::stable_sort(par)");
-		test<int>(test_size, test_round, [](const auto& a, const auto& b) {radix_sort(a, b, execution::par); }, "radix_sort(par)");
+//parallel radix sort from 1 thread up to the hardware, hybrid MSD-then-LSD against LSD passes over the whole range
+template <typename T>
+void bench_threads(const bench_options& opt)
+{
+	using namespace std;
+	auto size = opt.sizes.back();
+	if (size * sizeof(T) > opt.max_bytes)
+		return;
+	vector<bench_algorithm<T>> algorithms;
+	for (unsigned int thrd_num = 1; thrd_num <= radix_hardware_concurrency(); thrd_num *= 2)
+		for (size_t hybrid_limit : { size_t(0), numeric_limits<size_t>::max() })
+			algorithms.push_back({ string(hybrid_limit ? "radix_sort(par,lsd)" : "radix_sort(par,hybrid)"), thrd_num, [=](T* a, T* b) {
+				radix_sort_context ctx(thrd_num, 1);
+				ctx.hybrid_sort_length_limit = hybrid_limit;
+				radix_sort(a, b, execution::par, ctx);
+			} });
+	algorithms.push_back({ "std::sort(par)", radix_hardware_concurrency(), [](T* a, T* b) { sort(execution::par, a, b, bench_less<T>{}); } });
+	run<T>(opt, "uniform", make_input<T>("uniform", size), algorithms);
+}
 
-		test<size_t>(test_size, test_round, [](const auto& a, const auto& b) {sort(a, b); }, "std::sort");
-		test<size_t>(test_size, test_round, [](const auto& a, const auto& b) {stable_sort(a, b); }, "std::stable_sort");
-		test<size_t>(test_size, test_round, [](const auto& a, const auto& b) {radix_sort(a, b); }, "radix_sort");
+//cutoffs of radix_sort_context: small_sort_length_limit on many short ranges, presorted_tail_divisor on partly sorted input
+void bench_tuning(const bench_options& opt)
+{
+	using namespace std;
+	for (size_t test_size : { 8, 16, 32, 64, 128 })
+	{
+		//the input is cut into ranges of test_size, each sorted on its own
+		auto each = [test_size](auto sort) {
+			return [=](int* a, int* b) {
+				for (; a < b; a += test_size)
+					sort(a, min(a + test_size, b));
+			};
+		};
+		vector<bench_algorithm<int>> algorithms{ { "std::sort(" + to_string(test_size) + " each)", 1, each([](int* a, int* b) { sort(a, b); }), test_size } };
+		for (size_t limit : { size_t(0), size_t(16), size_t(32), size_t(64), size_t(128) })
+			algorithms.push_back({ "radix_sort(" + to_string(test_size) + " each,small_sort_length_limit=" + to_string(limit) + ")", 1, each([limit](int* a, int* b) {
+				static radix_sort_context ctx;
+				ctx.small_sort_length_limit = limit;
+				radix_sort(a, b, ctx);
+			}), test_size });
+		run<int>(opt, "uniform", make_input<int>("uniform", test_size * 100000), algorithms);
+	}
+	for (double sorted_fraction : { 1.0, 0.9, 0.75, 0.5 })
+	{
+		auto input = make_input<int>("uniform", 10000000);
+		sort(input.begin(), input.begin() + static_cast<size_t>(input.size() * sorted_fraction));
+		vector<bench_algorithm<int>> algorithms{ { "std::sort", 1, [](int* a, int* b) { sort(a, b); } } };
+		for (size_t divisor : { size_t(0), size_t(2), size_t(4), size_t(8) })
+			algorithms.push_back({ "radix_sort(presorted_tail_divisor=" + to_string(divisor) + ")", 1, [divisor](int* a, int* b) {
+				radix_sort_context ctx;
+				ctx.presorted_tail_divisor = divisor;
+				radix_sort(a, b, ctx);
+			} });
+		run<int>(opt, to_string(static_cast<int>(sorted_fraction * 100)) + "%_sorted", input, algorithms);
+	}
+	constexpr auto off = numeric_limits<size_t>::max();
+	for (auto distribution : { "few_unique", "uniform" })
+	{
+		vector<bench_algorithm<size_t>> algorithms;
+		for (size_t limit : { size_t(1) << 12, size_t(1) << 16, size_t(1) << 20, off })
+			algorithms.push_back({ "radix_sort(low_cardinality_length_limit=" + (limit == off ? string("off") : to_string(limit)) + ")", 1, [limit](size_t* a, size_t* b) {
+				radix_sort_context ctx;
+				ctx.low_cardinality_length_limit = limit;
+				radix_sort(a, b, ctx);
+			} });
+		for (size_t test_size : { size_t(1) << 14, size_t(1) << 18, size_t(1) << 22 })
+			run<size_t>(opt, distribution, make_input<size_t>(distribution, test_size), algorithms);
+	}
+}
 
-		test<size_t>(test_size, test_round, [](const auto& a, const auto& b) {sort(execution::par, a, b); }, "std::sort(par)");
-		test<size_t>(test_size, test_round, [](const auto& a, const auto& b) {stable_sort(execution::par, a, b); }, "std::stable_sort(par)");
-		test<size_t>(test_size, test_round, [](const auto& a, const auto& b) {radix_sort(a, b, execution::par); }, "radix_sort(par)");
+//files of random records on the local disk sorted with 1/32 and 1/8 of their size as memory budget, the partition pass
+//and the overlapped bucket sorts are both disk bound. the files go to the temp directory and are removed afterwards
+void bench_external(const bench_options& opt, size_t test_size, size_t rounds)
+{
+	using namespace std;
+	constexpr size_t divisors[] = { 32, 8 };
+	auto name = [](size_t divisor) { return "external_radix_sort(1/" + to_string(divisor) + " memory)"; };
+	auto selected = [&](size_t divisor) { return opt.filter.empty() || (name(divisor) + " " + type_name<size_t>() + " uniform").find(opt.filter) != string::npos; };
+	if (none_of(begin(divisors), end(divisors), selected))
+		return;
+	auto input = filesystem::temp_directory_path() / "radix_sort_benchmark.in";
+	auto output = filesystem::temp_directory_path() / "radix_sort_benchmark.out";
+	{
+		mt19937_64 e(114514);
+		vector<size_t> ar(min<size_t>(test_size, 1 << 20));
+		ofstream file(input, ios::binary);
+		for (size_t pos = 0; pos < test_size; pos += ar.size())
+		{
+			auto len = min(ar.size(), test_size - pos);
+			for (size_t k = 0; k < len; ++k)
+				ar[k] = e();
+			file.write(reinterpret_cast<const char*>(ar.data()), len * sizeof(size_t));
+		}
+	}
+	for (auto divisor : divisors)
+	{
+		if (!selected(divisor))
+			continue;
+		bench_result result{ name(divisor), type_name<size_t>(), "uniform", test_size, sizeof(size_t), 1, {} };
+		for (size_t i = 0; i < rounds; ++i)
+		{
+			auto beg = chrono::steady_clock::now();
+			external_radix_sort<size_t>(input, output, test_size * sizeof(size_t) / divisor);
+			result.ns.push_back(chrono::duration<double, nano>(chrono::steady_clock::now() - beg).count());
+		}
+		sort(result.ns.begin(), result.ns.end());
+		cout << result.algorithm << " " << result.type << " " << result.distribution << " " << result.size << ": "
+			<< result.ns_per_element(0.5) << " ns per element (p10 " << result.ns_per_element(0.1) << ", p90 " << result.ns_per_element(0.9) << "), "
+			<< result.gb_per_s() << " GB/s" << endl;
+		results.push_back(std::move(result));
+	}
+	filesystem::remove(input);
+	filesystem::remove(output);
+}
 
-		test_pair<int, unsigned int>(test_size, test_round, [](const auto& a, const auto& b) {sort(a, b); }, "std::sort");
-		test_pair<int, unsigned int>(test_size, test_round, [](const auto& a, const auto& b) {stable_sort(a, b); }, "std::stable_sort");
-		test_pair<int, unsigned int>(test_size, test_round, [](const auto& a, const auto& b) {radix_sort(a, b); }, "radix_sort");
+void write_csv(const std::string& path)
+{
+	using namespace std;
+	ofstream file(path);
+	file << "algorithm,type,distribution,size,element_bytes,threads,rounds,median_ns_per_element,p10_ns_per_element,p90_ns_per_element,min_ns_per_element,max_ns_per_element,median_gb_per_s\n";
+	for (auto& r : results)
+		file << '"' << r.algorithm << "\"," << r.type << ',' << r.distribution << ',' << r.size << ',' << r.element_bytes << ',' << r.threads << ',' << r.ns.size() << ','
+			<< r.ns_per_element(0.5) << ',' << r.ns_per_element(0.1) << ',' << r.ns_per_element(0.9) << ',' << r.ns_per_element(0) << ',' << r.ns_per_element(1) << ',' << r.gb_per_s() << '\n';
+}
 
-		test_pair<int, unsigned int>(test_size, test_round, [](const auto& a, const auto& b) {sort(execution::par, a, b); }, "std::sort(par)");
-		test_pair<int, unsigned int>(test_size, test_round, [](const auto& a, const auto& b) {stable_sort(execution::par, a, b); }, "std::stable_sort(par)");
-		test_pair<int, unsigned int>(test_size, test_round, [](const auto& a, const auto& b) {radix_sort(a, b, execution::par); }, "radix_sort(par)");
+void write_json(const std::string& path)
+{
+	using namespace std;
+	ofstream file(path);
+	file << "[\n";
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		auto& r = results[i];
+		file << "  {\"algorithm\": \"" << r.algorithm << "\", \"type\": \"" << r.type << "\", \"distribution\": \"" << r.distribution
+			<< "\", \"size\": " << r.size << ", \"element_bytes\": " << r.element_bytes << ", \"threads\": " << r.threads << ", \"rounds\": " << r.ns.size()
+			<< ", \"median_ns_per_element\": " << r.ns_per_element(0.5) << ", \"p10_ns_per_element\": " << r.ns_per_element(0.1)
+			<< ", \"p90_ns_per_element\": " << r.ns_per_element(0.9) << ", \"min_ns_per_element\": " << r.ns_per_element(0)
+			<< ", \"max_ns_per_element\": " << r.ns_per_element(1) << ", \"median_gb_per_s\": " << r.gb_per_s() << "}" << (i + 1 < results.size() ? ",\n" : "\n");
+	}
+	file << "]\n";
+}
 
-		test_pair<size_t, size_t>(test_size, test_round, [](const auto& a, const auto& b) {sort(a, b, [](const auto& a, const auto& b) {return a.first < b.first; }); }, "std::sort");
-		test_pair<size_t, size_t>(test_size, test_round, [](const auto& a, const auto& b) {stable_sort(a, b, [](const auto& a, const auto& b) { return a.first < b.first; }); }, "std::stable_sort");
-		test_pair<size_t, size_t>(test_size, test_round, [](const auto& a, const auto& b) {radix_sort<one_key<size_t, size_t>>(a, b); }, "radix_sort");
+bench_options parse_options(int argc, char** argv)
+{
+	using namespace std;
+	bench_options opt;
+	for (int i = 1; i < argc; ++i)
+	{
+		string arg = argv[i];
+		auto value = arg.substr(arg.find('=') + 1);
+		if (arg.starts_with("--sizes="))
+		{
+			opt.sizes.clear();
+			for (size_t pos = 0; pos < value.size();)
+			{
+				auto end = min(value.find(',', pos), value.size());
+				opt.sizes.push_back(static_cast<size_t>(stod(value.substr(pos, end - pos))));
+				pos = end + 1;
+			}
+		}
+		else if (arg.starts_with("--rounds="))
+			opt.rounds = max<size_t>(1, stoull(value));
+		else if (arg.starts_with("--max-bytes="))
+			opt.max_bytes = static_cast<size_t>(stod(value));
+		else if (arg.starts_with("--filter="))
+			opt.filter = value;
+		else if (arg.starts_with("--csv="))
+			opt.csv_path = value;
+		else if (arg.starts_with("--json="))
+			opt.json_path = value;
+		else if (arg == "--tuning")
+			opt.tuning = true;
+		else if (arg == "--external")
+			opt.external = true;
+		else
+			throw invalid_argument("unknown option " + arg);
+	}
+	if (opt.sizes.empty())
+		throw invalid_argument("--sizes needs at least one size");
+	return opt;
+}
 
-		test_pair<size_t, size_t>(test_size, test_round, [](const auto& a, const auto& b) {sort(execution::par, a, b, [](const auto& a, const auto& b) {return a.first < b.first; }); }, "std::sort(par)");
-		test_pair<size_t, size_t>(test_size, test_round, [](const auto& a, const auto& b) {stable_sort(execution::par, a, b, [](const auto& a, const auto& b) { return a.first < b.first; }); }, "std::stable_sort(par)");
-		test_pair<size_t, size_t>(test_size, test_round, [](const auto& a, const auto& b) {radix_sort<one_key<size_t, size_t>>(a, b, execution::par); }, "radix_sort(par)");
+int main(int argc, char** argv)
+{
+	using namespace std;
+	bench_options opt;
+	try
+	{
+		opt = parse_options(argc, argv);
+	}
+	catch (const exception& e)
+	{
+		cerr << e.what() << "\nusage: benchmark [--sizes=1e6,1e7] [--rounds=5] [--filter=text] [--max-bytes=n] [--csv=path] [--json=path] [--tuning] [--external]\n";
+		return 1;
 	}
 
+	bench_type<unsigned char>(opt);
+	bench_type<unsigned short>(opt);
+	bench_type<int>(opt);
+	bench_type<unsigned int>(opt);
+	bench_type<size_t>(opt);
+	bench_type<float>(opt);
+	bench_type<double>(opt);
+	bench_type<const char*>(opt);
+	bench_type<record<16>>(opt);
+	bench_type<record<32>>(opt);
+	bench_type<record<64>>(opt);
+	bench_type<record<128>>(opt);
 
-	return 0;
-}
\ No newline at end of file
+	bench_threads<unsigned int>(opt);
+	bench_threads<size_t>(opt);
+
+	if (opt.tuning)
+		bench_tuning(opt);
+	for (auto test_size : opt.sizes)
+		if (test_size * sizeof(size_t) <= opt.max_bytes)
+			bench_external(opt, test_size, opt.rounds);
+	//8GB, far beyond the memory budgets
+	if (opt.external)
+		bench_external(opt, 1000000000, 1);
+
+	if (!opt.csv_path.empty())
+		write_csv(opt.csv_path);
+	if (!opt.json_path.empty())
+		write_json(opt.json_path);
+	return unsorted_cases == 0 ? 0 : 1;
+}
@@ -1,5 +1,7 @@
 #include "../include/radix_sort.hpp"
 #include<algorithm>
+#include<fstream>
+#include<cstdio>
 
 struct mystruct
 {
@@ -15,7 +17,7 @@ struct radix_trait<mystruct>
 	static unsigned char get(const mystruct& obj) noexcept
 	{
 		static_assert(index < radix_size);
-		return radix_trait<p1>::get<index>(obj.key);
+		return radix_trait<double>::get<index>(obj.key);
 	}
 };
 
@@ -23,13 +25,13 @@ struct my_trait
 {
 	static constexpr std::size_t radix_size = sizeof(std::pair<int,int>) / sizeof(unsigned char);
 	template <size_t index>
-	static unsigned char get(const mystruct& obj) noexcept
+	static unsigned char get(const std::pair<int,int>& obj) noexcept
 	{
 		static_assert(index < radix_size);
         if constexpr (index < sizeof(int))
-			return radix_trait_greater<p2>::get<index>(obj.second);
+			return radix_trait_greater<int>::get<index>(obj.second);
 		else
-			return radix_trait<p1>::get<index - sizeof(p2)>(obj.first);
+			return radix_trait<int>::get<index - sizeof(int)>(obj.first);
 	}
 };
 
@@ -47,7 +49,7 @@ int main()
     }
     {
         std::vector<size_t> ar={2,3,1};
-        radix_sort<radix_trait_greater<unsigned short>>(ar.begin(),ar.end());
+        radix_sort<radix_trait_greater<size_t>>(ar.begin(),ar.end());
         //descending order
     }
     {
@@ -55,13 +57,18 @@ int main()
         radix_sort(ar.begin(),ar.end());
         //support floating point
     }
+    {
+        std::vector<unsigned int> ar={2,3,1};
+        radix_sort<radix_trait<unsigned int,11>>(ar.begin(),ar.end());
+        //three 11-bit digit passes instead of four byte passes
+    }
     {
         std::vector<std::pair<int,int>> ar={{2,3},{0,1},{5,4}};
         radix_sort(ar.begin(),ar.end());
         //support std::pair
     }
     {
-        std::vector<void*> ar={0x300000,0x0,0x60000000};
+        std::vector<void*> ar={(void*)0x300000,nullptr,(void*)0x60000000};
         radix_sort(ar.begin(),ar.end());
         //support T*
     }
@@ -77,7 +84,7 @@ int main()
         //first key ascending order,second key descending order
     }
     {
-        unsigned char buf[sizeof(int)*5];
+        int buf[5];
         std::vector<int> ar={5,3,2,6,3};
         radix_sort(ar.begin(),ar.end(),buf);
         //support user-supplied buffer
@@ -87,5 +94,129 @@ int main()
         radix_sort(ar.begin(),ar.end(),std::execution::par);
         //multi-threads parallel sorting
     }
+    {
+        radix_thread_pool pool(4);
+        std::vector<int> ar{3,5,1,3,6};
+        parallel_radix_sort(ar.begin(),ar.end(),nullptr,4,pool);
+        //schedule on a caller-owned pool instead of radix_thread_pool::global()
+    }
+    {
+        radix_sort_context ctx(8,50000);
+        std::vector<int> ar{3,5,1,3,6};
+        radix_sort(ar.begin(),ar.end(),std::execution::par,ctx);
+        radix_sort(ar.begin(),ar.end(),ctx);
+        //reuse scratch memory across calls, set thread count and per-thread grain
+    }
+    {
+        std::vector<int> ar{3,5,1,3,6};
+        inplace_radix_sort(ar.begin(),ar.end());
+        inplace_radix_sort(ar.begin(),ar.end(),std::execution::par);
+        //in-place MSD radix sort, no O(n) buffer, not stable
+    }
+    {
+        std::vector<mystruct> ar={{1.0,2},{-1.4,123},{-1.4,0}};
+        std::vector<unsigned int> idx(ar.size());
+        radix_argsort(ar.begin(),ar.end(),idx.begin());
+        indirect_radix_sort(ar.begin(),ar.end(),std::execution::par);
+        //idx gets the sorted order, indirect_radix_sort sorts (key,index) records and moves each element once
+    }
+    {
+        std::vector<unsigned long long> key={3,1,2};
+        std::vector<double> val={0.3,0.1,0.2};
+        std::vector<int> tag={30,10,20};
+        radix_sort_by_key(key.begin(),key.end(),val.begin());
+        radix_sort_by_key(key.begin(),key.end(),std::make_tuple(val.begin(),tag.begin()),std::execution::par);
+        //sort separate key and value columns without zipping them into pairs
+    }
+    {
+        std::vector<std::string> ar={"b","a","ab",""};
+        radix_sort(ar.begin(),ar.end());
+        //MSD radix sort for std::string, std::string_view and byte spans
+    }
+    {
+        radix_sort_context ctx;
+        ctx.small_sort_length_limit=16;
+        ctx.presorted_tail_divisor=8;
+        std::vector<int> ar{1,2,3,4,6,5};
+        radix_sort(ar.begin(),ar.end(),ctx);
+        //short inputs are insertion sorted, a sorted prefix only gets its unsorted tail sorted and merged in
+    }
+    {
+        std::vector<unsigned int> ar{3,5,1,3,6};
+        auto path=std::filesystem::temp_directory_path()/"records.bin";
+        std::ofstream(path,std::ios::binary).write((const char*)ar.data(),ar.size()*sizeof(unsigned int));
+        external_radix_sort<unsigned int>(path,path,size_t(1)<<30);
+        std::filesystem::remove(path);
+        //sort a file of fixed-size records larger than memory, within a memory budget in bytes
+    }
+    {
+        std::vector<int> ar{3,5,1,3,6,2};
+        radix_nth_element(ar.begin(),ar.begin()+3,ar.end());
+        radix_partial_sort(ar.begin(),ar.begin()+2,ar.end(),std::execution::par);
+        auto last=radix_top_k<radix_trait_greater<int>>(ar.begin(),ar.end(),2);
+        radix_sort<radix_trait_greater<int>>(ar.begin(),last);
+        //select by the most significant digits without a full sort, radix_trait_greater gives the largest k, sorted here in [begin,last)
+    }
+    {
+        std::vector<unsigned int> ar{0x300,0x1ff,0x305,0x102},out(ar.size());
+        auto offset=radix_partition(ar.begin(),ar.end(),out.begin(),radix_digit_range<1>{});
+        //group by bits 8-15 without sorting, bucket k is out[offset[k],offset[k+1])
+    }
+    {
+        std::vector<int> ar{3,1,2,9,8,7,5};
+        std::vector<size_t> offset{0,3,3,7};
+        segmented_radix_sort(ar.begin(),offset.begin(),3,std::execution::par);
+        //sort ar[offset[s],offset[s+1]) for each of 3 segments with one shared buffer
+    }
+    {
+        std::vector<int> ar{1,4,9},batch{7,2},out(5);
+        radix_sort_merge(ar.begin(),ar.end(),batch.begin(),batch.end(),out.begin(),std::execution::par);
+        out={1,4,9,7,2};
+        radix_sort_merge(out.begin(),out.begin()+3,out.end());
+        //radix sort only a new batch and merge it into already sorted data, to out or in place
+    }
+    {
+        std::vector<unsigned int> ar(1<<15);
+        for(unsigned int k=0;k<ar.size();++k)
+            ar[k]=k*2654435761u;
+        radix_sort<radix_instrumented<radix_trait<unsigned int>,radix_stats_sink<>>>(ar.begin(),ar.end(),std::execution::par);
+        auto& stats=radix_stats_sink<>::stats();
+        std::printf("%zu elements counted, %zu bytes moved\n",stats.counted,stats.bytes_moved);
+        //per-digit pass times, skipped passes, bucket skew, bytes moved, allocations and thread imbalance,
+        //or derive from radix_sort_sink to get every event. plain traits compile no instrumentation
+    }
+    {
+        std::vector<unsigned short> ar{3,5,1,3,6};
+        radix_sort(ar.begin(),ar.end());
+        radix_sort_context ctx;
+        ctx.low_cardinality_length_limit=1<<20;
+        std::vector<double> few{0.5,-1.0,0.5,2.0,-1.0};
+        radix_sort(few.begin(),few.end(),ctx);
+        //1 and 2 byte keys are counted and written back as runs, no buffer. from low_cardinality_length_limit on,
+        //inputs whose sample has at most 32 distinct keys are sorted by the rank of their key in one pass
+    }
+    {
+        std::vector<int> a{3,5,1},b{9,7,8};
+        auto ta=radix_sort_async(a.begin(),a.end(),std::execution::par);
+        auto tb=radix_sort_async(b.begin(),b.end());
+        tb.cancel();
+        ta.get();
+        //sorts run on the workers of radix_thread_pool::global() and share them while the caller goes on,
+        //get() waits and rethrows, cancel() stops a sort between digit passes, a radix_sort_task can be co_awaited
+    }
+    {
+        enum class level : unsigned char {low,high};
+        struct order_line {level lv; int day; double price;};
+        std::vector<order_line> ar={{level::high,3,9.5},{level::low,3,-1.0},{level::high,1,2.0}};
+        using trait=radix_key_trait<order_line,
+            radix_field<&order_line::lv,radix_order::descending,level::low,level::high>,
+            radix_field<&order_line::day,radix_order::ascending,0,366>,
+            radix_field<&order_line::price,radix_order::descending>>;
+        radix_sort<trait>(ar.begin(),ar.end());
+        std::vector<std::tuple<short,float>> tup={{1,-0.5f},{1,-2.0f},{0,3.0f}};
+        radix_sort(tup.begin(),tup.end());
+        //compose a key from fields at compile time, first field most significant, each ascending or descending.
+        //declared ranges and bools only take the bits they need: 1+9+64 bits here, 10 byte passes instead of 13
+    }
     return 0;
 }
\ No newline at end of file
@@ -2,352 +2,4374 @@
 #include <vector>
 #include <array>
 #include <execution>
-#include <future>
+#include <mutex>
+#include <condition_variable>
 #include <memory>
 #include <cstring>
 #include <limits>
+#include <climits>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <utility>
+#include <exception>
+#include <tuple>
+#include <cstdint>
+#include <bit>
+#include <type_traits>
+#include <iterator>
+#include <span>
+#include <string>
+#include <string_view>
+#include <cstdio>
+#include <cerrno>
+#include <filesystem>
+#include <future>
+#include <random>
+#include <stdexcept>
+#include <system_error>
+#include <chrono>
+#include <functional>
+#include <deque>
+#include <stop_token>
+#include <coroutine>
+
+#if (defined(__x86_64__) || defined(_M_X64)) && !defined(RADIX_SORT_NO_SIMD)
+#define RADIX_SORT_X86_64 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define RADIX_SORT_TARGET(isa)
+#else
+#include <cpuid.h>
+#define RADIX_SORT_TARGET(isa) __attribute__((target(isa)))
+#endif
+#else
+#define RADIX_SORT_X86_64 0
+#endif
+
+template <typename T, size_t digit_bits = 8>
+class radix_trait;
+
+template <typename T, size_t digit_bits = 8>
+class radix_trait_greater;
+
+//digit width of a trait, traits without digit_bits sort by bytes
+template <typename Trait>
+constexpr size_t radix_digit_bits_v = [] {
+	if constexpr (requires { Trait::digit_bits; })
+		return static_cast<size_t>(Trait::digit_bits);
+	else
+		return static_cast<size_t>(CHAR_BIT);
+}();
+
+template <typename Trait>
+constexpr size_t radix_bucket_num_v = size_t(1) << radix_digit_bits_v<Trait>;
+
+template <typename Trait, typename cnt_type>
+using radix_counter = std::array<cnt_type, radix_bucket_num_v<Trait>>;
+
+template <typename Trait, typename cnt_type>
+using radix_histograms = std::array<radix_counter<Trait, cnt_type>, Trait::radix_size>;
+
+template <size_t digit_bits>
+using radix_digit_t = std::conditional_t<digit_bits <= 8, unsigned char, std::conditional_t<digit_bits <= 16, unsigned short, unsigned int>>;
+
+//number of digit_bits wide digits covering key_bytes bytes
+template <size_t key_bytes, size_t digit_bits>
+constexpr size_t radix_digit_num_v = (key_bytes * CHAR_BIT + digit_bits - 1) / digit_bits;
+
+//the index-th digit_bits wide digit of key, counted from the least significant one
+template <size_t index, size_t digit_bits>
+constexpr radix_digit_t<digit_bits> radix_extract(std::uint64_t key) noexcept
+{
+	static_assert(digit_bits <= 16, "counter arrays grow with 2^digit_bits");
+	return static_cast<radix_digit_t<digit_bits>>((key >> (index * digit_bits)) & ((std::uint64_t(1) << digit_bits) - 1));
+}
+
+//bit pattern of a scalar key as an unsigned integer
+template <typename T>
+	requires (sizeof(T) <= sizeof(std::uint64_t))
+std::uint64_t radix_key_bits(const T& obj) noexcept
+{
+	if constexpr (std::is_pointer_v<T>)
+		return reinterpret_cast<std::uintptr_t>(obj);
+	else if constexpr (std::is_integral_v<T>)
+		return static_cast<std::make_unsigned_t<T>>(obj);
+	else if constexpr (sizeof(T) == sizeof(std::uint32_t))
+		return std::bit_cast<std::uint32_t>(obj);
+	else
+		return std::bit_cast<std::uint64_t>(obj);
+}
+
+//key bits of a float xor this mask order like sign and magnitude: a negative float has every bit but the sign flipped,
+//so larger magnitudes come first. 0 for every other scalar, whose key bits only need a constant mask
+template <typename T>
+std::uint64_t radix_magnitude_mask(std::uint64_t bits) noexcept
+{
+	if constexpr (std::is_floating_point_v<T>)
+	{
+		constexpr auto sign_shift = sizeof(T) * CHAR_BIT - 1;
+		return (std::uint64_t(0) - ((bits >> sign_shift) & 1)) & ((std::uint64_t(1) << sign_shift) - 1);
+	}
+	else
+		return 0;
+}
+
+//std::thread::hardware_concurrency() reads sysfs on every call, which would outweigh sorting a short range
+inline unsigned int radix_hardware_concurrency() noexcept
+{
+	static const unsigned int thrd_num = std::thread::hardware_concurrency();
+	return thrd_num;
+}
+
+//persistent workers shared by every parallel sort, the calling thread always takes part in its own job.
+//workers also run submitted background tasks, after helping the parallel_for jobs in flight
+class radix_thread_pool
+{
+public:
+	static constexpr unsigned int max_participants = 128;
+
+	explicit radix_thread_pool(unsigned int worker_num = std::max(1u, radix_hardware_concurrency()) - 1)
+	{
+		workers.reserve(worker_num);
+		for (auto i = 0u; i < worker_num; ++i)
+			workers.emplace_back([this] { work_loop(); });
+	}
+	radix_thread_pool(const radix_thread_pool&) = delete;
+	radix_thread_pool& operator=(const radix_thread_pool&) = delete;
+	~radix_thread_pool()
+	{
+		{
+			std::lock_guard lock(mtx);
+			stop = true;
+		}
+		wake_cv.notify_all();
+		for (auto& worker : workers)
+			worker.join();
+	}
+
+	unsigned int size() const noexcept
+	{
+		return static_cast<unsigned int>(workers.size()) + 1;
+	}
+
+	static radix_thread_pool& global()
+	{
+		static radix_thread_pool pool;
+		return pool;
+	}
+
+	//index of the calling thread among the participants of the job it runs, 0 for the thread that started the job
+	static unsigned int participant() noexcept
+	{
+		return current_participant;
+	}
+
+	//call func(k) for every k in [0,task_num) on at most thrd_lim threads,
+	//each participant owns a contiguous slice of tasks and steals from the others once it runs dry.
+	//the first exception thrown by func stops handing out tasks and is rethrown here once every participant has left
+	template <typename Func>
+	void parallel_for(size_t task_num, Func&& func, unsigned int thrd_lim = max_participants)
+	{
+		thrd_lim = static_cast<unsigned int>(std::min<size_t>({ thrd_lim, size(), max_participants, task_num }));
+		if (thrd_lim <= 1)
+		{
+			for (size_t k = 0; k < task_num; ++k)
+				func(k);
+			return;
+		}
+		job jb;
+		jb.func = &func;
+		jb.invoke = [](void* f, size_t k) { (*static_cast<std::remove_reference_t<Func>*>(f))(k); };
+		jb.slice_num = jb.participants = thrd_lim;
+		for (auto t = 0u; t < thrd_lim; ++t)
+		{
+			jb.slices[t].next.store(task_num * t / thrd_lim, std::memory_order_relaxed);
+			jb.slices[t].end = task_num * (t + 1) / thrd_lim;
+		}
+		{
+			std::lock_guard lock(mtx);
+			(queue_tail ? queue_tail->next : queue_head) = &jb;
+			queue_tail = &jb;
+		}
+		wake_cv.notify_all();
+		jb.run(0);
+		{
+			std::unique_lock lock(mtx);
+			if (jb.queued)
+				dequeue(&jb);
+			done_cv.wait(lock, [&] { return jb.finished == jb.joined - 1; });
+		}
+		if (jb.error)
+			std::rethrow_exception(jb.error);
+	}
+
+	//run task on a worker without waiting for it, false when the pool has no worker to run it.
+	//tasks still queued when the pool is destroyed run before the workers exit. nobody waits for a task,
+	//so an exception escaping it is dropped, a task that must report failure catches it itself
+	bool submit(std::function<void()> task)
+	{
+		if (workers.empty())
+			return false;
+		{
+			std::lock_guard lock(mtx);
+			tasks.push_back(std::move(task));
+		}
+		wake_cv.notify_one();
+		return true;
+	}
+
+private:
+	struct alignas(64) slice
+	{
+		std::atomic<size_t> next;
+		size_t end;
+	};
+
+	struct job
+	{
+		void* func;
+		void (*invoke)(void*, size_t);
+		unsigned int slice_num, participants, joined = 1, finished = 0;
+		bool queued = true;
+		job* next = nullptr;
+		std::atomic<bool> failed = false;
+		std::exception_ptr error;
+		slice slices[max_participants];
+
+		void run(unsigned int id)
+		{
+			auto outer = std::exchange(current_participant, id);
+			try
+			{
+				for (auto t = 0u; t < slice_num; ++t)
+				{
+					auto& s = slices[(id + t) % slice_num];
+					for (size_t k; !failed.load(std::memory_order_relaxed) && (k = s.next.fetch_add(1, std::memory_order_relaxed)) < s.end;)
+						invoke(func, k);
+				}
+			}
+			catch (...)
+			{
+				if (!failed.exchange(true))
+					error = std::current_exception();
+			}
+			current_participant = outer;
+		}
+	};
+
+	void dequeue(job* jb)
+	{
+		job** link = &queue_head;
+		job* prev = nullptr;
+		while (*link != jb)
+		{
+			prev = *link;
+			link = &prev->next;
+		}
+		*link = jb->next;
+		if (queue_tail == jb)
+			queue_tail = prev;
+		jb->queued = false;
+	}
+
+	void work_loop()
+	{
+		std::unique_lock lock(mtx);
+		for (;;)
+		{
+			wake_cv.wait(lock, [&] { return stop || queue_head || !tasks.empty(); });
+			if (!queue_head)
+			{
+				if (tasks.empty())
+					return;
+				auto task = std::move(tasks.front());
+				tasks.pop_front();
+				lock.unlock();
+				try
+				{
+					task();
+				}
+				catch (...)
+				{
+				}
+				lock.lock();
+				continue;
+			}
+			auto jb = queue_head;
+			auto id = jb->joined++;
+			if (jb->joined == jb->participants)
+				dequeue(jb);
+			lock.unlock();
+			jb->run(id);
+			lock.lock();
+			if (++jb->finished == jb->joined - 1 && !jb->queued)
+				done_cv.notify_all();
+		}
+	}
+
+	std::vector<std::thread> workers;
+	std::mutex mtx;
+	std::condition_variable wake_cv, done_cv;
+	job* queue_head = nullptr;
+	job* queue_tail = nullptr;
+	std::deque<std::function<void()>> tasks;
+	bool stop = false;
+	static inline thread_local unsigned int current_participant = 0;
+};
+
+//instrumentation: radix_instrumented<Trait, Sink> sorts exactly like Trait and also hands the static members of Sink
+//an event for every counting read, pass, parallel phase and scratch request of the LSD sorts. plain traits compile none of it
+using radix_clock = std::chrono::steady_clock;
+
+enum class radix_phase
+{
+	count, //histograms of the chunks
+	prefix, //merging the chunk histograms into scatter positions
+	scatter,
+	copy, //moving the result from buffer back into the range
+	buckets //hybrid sort: sorting the top digit buckets one per task
+};
+
+//histograms of every digit built with one read of length elements
+struct radix_count_event
+{
+	size_t length;
+	radix_clock::duration time;
+};
+
+//one pass on digit, digit == radix_size is the final move out of the buffer. a skipped pass moved nothing because every
+//element had the same digit, a max_bucket close to length over few used_buckets marks a skewed key distribution
+struct radix_pass_event
+{
+	size_t digit;
+	size_t length;
+	bool skipped;
+	size_t used_buckets;
+	size_t max_bucket;
+	size_t bytes_moved;
+	radix_clock::duration time;
+};
+
+//one parallel phase, indexed by radix_thread_pool::participant(): how long after the launch each thread took its
+//first task and how long it was busy
+struct radix_thread_event
+{
+	radix_phase phase;
+	size_t digit;
+	radix_clock::duration wall;
+	std::array<bool, radix_thread_pool::max_participants> joined;
+	std::array<radix_clock::duration, radix_thread_pool::max_participants> start, busy;
+
+	unsigned int thread_num() const noexcept
+	{
+		return static_cast<unsigned int>(std::count(joined.begin(), joined.end(), true));
+	}
+
+	//busiest thread over the mean, 1 is perfectly balanced
+	double imbalance() const noexcept
+	{
+		radix_clock::duration sum{}, max{};
+		for (size_t t = 0; t < joined.size(); ++t)
+			if (joined[t])
+			{
+				sum += busy[t];
+				max = std::max(max, busy[t]);
+			}
+		return sum.count() ? static_cast<double>(max.count()) * thread_num() / sum.count() : 1;
+	}
+};
+
+//a sort asked its context for bytes of scratch memory, allocated is true when the context had to grow for it
+struct radix_alloc_event
+{
+	size_t bytes;
+	bool allocated;
+};
+
+//sink that ignores everything, sinks derive from it and hide the members they need.
+//events of buckets sorted on pool threads arrive from those threads at the same time
+struct radix_sort_sink
+{
+	static void on_count(const radix_count_event&) {}
+	static void on_pass(const radix_pass_event&) {}
+	static void on_threads(const radix_thread_event&) {}
+	static void on_alloc(const radix_alloc_event&) {}
+};
+
+template <typename Trait, typename Sink = radix_sort_sink>
+struct radix_instrumented : Trait
+{
+	using base_trait = Trait;
+	using sink_type = Sink;
+};
+
+template <typename Trait>
+concept radix_instrumented_trait = requires { typename Trait::sink_type; };
+
+template <typename Trait>
+struct radix_base_trait
+{
+	using type = Trait;
+};
+
+template <radix_instrumented_trait Trait>
+struct radix_base_trait<Trait>
+{
+	using type = typename Trait::base_trait;
+};
+
+//the trait an instrumented trait wraps, so that kernels picked by trait identity still apply
+template <typename Trait>
+using radix_base_trait_t = typename radix_base_trait<Trait>::type;
+
+//totals of the events reported to radix_stats_sink
+struct radix_sort_stats
+{
+	struct digit_stats
+	{
+		size_t passes = 0, skipped = 0;
+		size_t max_bucket = 0; //fullest bucket of any pass on this digit
+		radix_clock::duration time{};
+	};
+
+	size_t counted = 0; //elements read to build histograms
+	size_t bytes_moved = 0;
+	size_t requested_bytes = 0, allocations = 0, allocated_bytes = 0;
+	radix_clock::duration count_time{}, copy_time{};
+	radix_clock::duration max_thread_start{}; //longest wait of a thread for its first task
+	double max_imbalance = 1; //of any parallel phase
+	std::vector<digit_stats> digit;
+};
+
+//sink that sums every event into stats(), one set of totals per Tag
+template <typename Tag = void>
+struct radix_stats_sink : radix_sort_sink
+{
+	static radix_sort_stats& stats() noexcept
+	{
+		static radix_sort_stats totals;
+		return totals;
+	}
+
+	static void reset()
+	{
+		std::lock_guard lock(mutex());
+		stats() = {};
+	}
+
+	static void on_count(const radix_count_event& e)
+	{
+		std::lock_guard lock(mutex());
+		stats().counted += e.length;
+		stats().count_time += e.time;
+	}
+
+	static void on_pass(const radix_pass_event& e)
+	{
+		std::lock_guard lock(mutex());
+		auto& totals = stats();
+		totals.bytes_moved += e.bytes_moved;
+		if (e.max_bucket == 0) //the move out of the buffer
+		{
+			totals.copy_time += e.time;
+			return;
+		}
+		if (totals.digit.size() <= e.digit)
+			totals.digit.resize(e.digit + 1);
+		auto& d = totals.digit[e.digit];
+		++d.passes;
+		d.skipped += e.skipped;
+		d.max_bucket = std::max(d.max_bucket, e.max_bucket);
+		d.time += e.time;
+	}
+
+	static void on_threads(const radix_thread_event& e)
+	{
+		std::lock_guard lock(mutex());
+		auto& totals = stats();
+		for (size_t t = 0; t < e.joined.size(); ++t)
+			if (e.joined[t])
+				totals.max_thread_start = std::max(totals.max_thread_start, e.start[t]);
+		totals.max_imbalance = std::max(totals.max_imbalance, e.imbalance());
+	}
+
+	static void on_alloc(const radix_alloc_event& e)
+	{
+		std::lock_guard lock(mutex());
+		stats().requested_bytes += e.bytes;
+		stats().allocations += e.allocated;
+		stats().allocated_bytes += e.allocated ? e.bytes : 0;
+	}
+
+private:
+	static std::mutex& mutex()
+	{
+		static std::mutex m;
+		return m;
+	}
+};
+
+//the current time for an instrumented Trait, a constant otherwise
+template <typename Trait>
+radix_clock::time_point radix_instrument_now() noexcept
+{
+	if constexpr (radix_instrumented_trait<Trait>)
+		return radix_clock::now();
+	else
+		return {};
+}
+
+template <typename Trait>
+void radix_report_count(size_t length, radix_clock::time_point beg)
+{
+	if constexpr (radix_instrumented_trait<Trait>)
+		Trait::sink_type::on_count({ length, radix_clock::now() - beg });
+}
+
+//bucket statistics of a pass on digit i from the digit's histogram, which is an inclusive prefix sum when prefix.
+//read before the scatter counts the histogram down, empty for plain traits
+template <size_t i, typename Trait, typename cnt_type>
+radix_pass_event radix_pass_stats(const radix_counter<Trait, cnt_type>& counter, bool prefix, size_t length)
+{
+	radix_pass_event e{ i, length, false, 0, 0, 0, {} };
+	if constexpr (radix_instrumented_trait<Trait>)
+		for (size_t k = 0; k < radix_bucket_num_v<Trait>; ++k)
+		{
+			size_t n = prefix && k ? counter[k] - counter[k - 1] : counter[k];
+			e.used_buckets += n != 0;
+			e.max_bucket = std::max(e.max_bucket, n);
+		}
+	return e;
+}
+
+template <typename Trait>
+void radix_report_pass(radix_pass_event e, size_t bytes_moved, radix_clock::time_point beg)
+{
+	if constexpr (radix_instrumented_trait<Trait>)
+	{
+		e.bytes_moved = bytes_moved;
+		e.time = radix_clock::now() - beg;
+		Trait::sink_type::on_pass(e);
+	}
+}
+
+template <size_t i, typename Trait>
+void radix_report_skipped(size_t length)
+{
+	if constexpr (radix_instrumented_trait<Trait>)
+		Trait::sink_type::on_pass({ i, length, true, 1, length, 0, {} });
+}
+
+template <typename Trait>
+void radix_report_copy(size_t length, size_t bytes_moved, radix_clock::time_point beg)
+{
+	if constexpr (radix_instrumented_trait<Trait>)
+		Trait::sink_type::on_pass({ Trait::radix_size, length, false, 0, 0, bytes_moved, radix_clock::now() - beg });
+}
+
+//pool.parallel_for, for an instrumented Trait timing every participant of the phase
+template <typename Trait, typename Func>
+void radix_parallel_for(radix_thread_pool& pool, size_t task_num, Func&& func, unsigned int thrd_lim, radix_phase phase, size_t digit = 0)
+{
+	if constexpr (radix_instrumented_trait<Trait>)
+	{
+		radix_thread_event e{ phase, digit, {}, {}, {}, {} };
+		auto launch = radix_clock::now();
+		pool.parallel_for(task_num, [&](size_t k) {
+			auto beg = radix_clock::now();
+			auto id = radix_thread_pool::participant();
+			if (!e.joined[id])
+			{
+				e.joined[id] = true;
+				e.start[id] = beg - launch;
+			}
+			func(k);
+			e.busy[id] += radix_clock::now() - beg;
+		}, thrd_lim);
+		e.wall = radix_clock::now() - launch;
+		Trait::sink_type::on_threads(e);
+	}
+	else
+		pool.parallel_for(task_num, std::forward<Func>(func), thrd_lim);
+}
+
+//scratch memory and thread settings reused across sort calls, so steady-state sorting performs no allocation.
+//a context must not be used by two sorts at the same time
+class radix_sort_context
+{
+public:
+	static constexpr size_t default_thrd_sort_length_limit = 100000;
+	static constexpr size_t default_small_sort_length_limit = 32;
+	static constexpr size_t default_presorted_tail_divisor = 4;
+	static constexpr size_t default_hybrid_sort_length_limit = 0;
+	static constexpr size_t default_segment_sort_length_limit = 256;
+	static constexpr size_t default_low_cardinality_length_limit = 1 << 16;
+
+	unsigned int thrd_lim = radix_hardware_concurrency();
+	size_t thrd_sort_length_limit = default_thrd_sort_length_limit; //each thread's min sort length
+	size_t small_sort_length_limit = default_small_sort_length_limit; //inputs up to this length are insertion sorted
+	size_t presorted_tail_divisor = default_presorted_tail_divisor; //a sorted prefix is kept when at most length / divisor follows it, 0 turns the scan off
+	size_t hybrid_sort_length_limit = default_hybrid_sort_length_limit; //parallel sorts from this length split on the top digit, then sort each bucket on one thread
+	size_t segment_sort_length_limit = default_segment_sort_length_limit; //segments up to this length take one counting pass and an insertion sort
+	size_t low_cardinality_length_limit = default_low_cardinality_length_limit; //inputs from this length are sampled for a few distinct keys, which are sorted by rank
+	radix_thread_pool* pool = nullptr; //nullptr means radix_thread_pool::global()
+	std::stop_token stop_token; //a stop request ends the LSD sorts between digit passes and leaves the range unsorted
+	bool stopped_early = false; //set by a sort that a stop request ended before its last pass, never cleared by the sorts
+
+	radix_sort_context() = default;
+	explicit radix_sort_context(unsigned int thrd_lim, size_t thrd_sort_length_limit = default_thrd_sort_length_limit, radix_thread_pool* pool = nullptr) noexcept
+		: thrd_lim(thrd_lim), thrd_sort_length_limit(thrd_sort_length_limit), pool(pool)
+	{
+	}
+
+	//uninitialized storage for n objects of T, valid until the next call asking for more
+	template <typename T>
+	T* buffer(size_t n)
+	{
+		return static_cast<T*>(scratch.reserve(n * sizeof(T)));
+	}
+
+	template <typename T>
+	T* counter(size_t n)
+	{
+		return static_cast<T*>(counters.reserve(n * sizeof(T)));
+	}
+
+	radix_thread_pool& thread_pool() const noexcept
+	{
+		return pool ? *pool : radix_thread_pool::global();
+	}
+
+	//how many threads are worth starting for length elements
+	unsigned int thread_num(size_t length) const noexcept
+	{
+		return static_cast<unsigned int>(std::min<size_t>(thrd_lim, std::max<size_t>(1u, length / std::max<size_t>(1u, thrd_sort_length_limit))));
+	}
+
+	void release() noexcept
+	{
+		scratch = storage{};
+		counters = storage{};
+	}
+
+	//scratch memory held for the next sorts
+	size_t reserved_bytes() const noexcept
+	{
+		return scratch.size + counters.size;
+	}
+
+private:
+	struct aligned_delete
+	{
+		void operator()(void* p) const noexcept
+		{
+			::operator delete(p, std::align_val_t{ 64 });
+		}
+	};
+
+	struct storage
+	{
+		std::unique_ptr<void, aligned_delete> data;
+		size_t size = 0;
+
+		void* reserve(size_t n)
+		{
+			if (n > size)
+			{
+				//the old block stays in place until the new one exists, a failed allocation leaves the context usable
+				n = std::max(n, size + size / 2);
+				std::unique_ptr<void, aligned_delete> block(::operator new(n, std::align_val_t{ 64 }));
+				data = std::move(block);
+				size = n;
+			}
+			return data.get();
+		}
+	};
+
+	storage scratch, counters;
+};
+
+//ctx.buffer<T>(n) that tells the sink of an instrumented Trait what was asked for
+template <typename Trait, typename T>
+T* radix_context_buffer(radix_sort_context& ctx, size_t n)
+{
+	if constexpr (radix_instrumented_trait<Trait>)
+	{
+		auto reserved = ctx.reserved_bytes();
+		auto p = ctx.buffer<T>(n);
+		Trait::sink_type::on_alloc({ n * sizeof(T), ctx.reserved_bytes() != reserved });
+		return p;
+	}
+	else
+		return ctx.buffer<T>(n);
+}
+
+template <typename Trait, typename T>
+T* radix_context_counter(radix_sort_context& ctx, size_t n)
+{
+	if constexpr (radix_instrumented_trait<Trait>)
+	{
+		auto reserved = ctx.reserved_bytes();
+		auto p = ctx.counter<T>(n);
+		Trait::sink_type::on_alloc({ n * sizeof(T), ctx.reserved_bytes() != reserved });
+		return p;
+	}
+	else
+		return ctx.counter<T>(n);
+}
+
+//runtime CPU dispatch for the counting kernels, define RADIX_SORT_NO_SIMD to keep the portable loops only
+struct radix_cpu_features
+{
+	bool avx512f = false;
+};
+
+inline const radix_cpu_features& radix_cpu() noexcept
+{
+	static const radix_cpu_features features = [] {
+		radix_cpu_features f;
+#if RADIX_SORT_X86_64
+		unsigned int regs[4] = {};
+#if defined(_MSC_VER) && !defined(__clang__)
+		__cpuid(reinterpret_cast<int*>(regs), 0);
+		auto max_leaf = regs[0];
+		__cpuidex(reinterpret_cast<int*>(regs), 1, 0);
+		bool osxsave = regs[2] & (1u << 27);
+		unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+		if (max_leaf >= 7)
+			__cpuidex(reinterpret_cast<int*>(regs), 7, 0);
+		else
+			regs[1] = 0;
+#else
+		auto max_leaf = __get_cpuid_max(0, nullptr);
+		__get_cpuid(1, &regs[0], &regs[1], &regs[2], &regs[3]);
+		bool osxsave = regs[2] & (1u << 27);
+		unsigned int xcr0_lo = 0, xcr0_hi = 0;
+		if (osxsave)
+			__asm__("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+		unsigned long long xcr0 = (static_cast<unsigned long long>(xcr0_hi) << 32) | xcr0_lo;
+		if (max_leaf < 7 || !__get_cpuid_count(7, 0, &regs[0], &regs[1], &regs[2], &regs[3]))
+			regs[1] = 0;
+#endif
+		//the OS must save XMM, YMM, opmask and both halves of the ZMM registers
+		f.avx512f = (xcr0 & 0xe6) == 0xe6 && (regs[1] & (1u << 16));
+#endif
+		return f;
+	}();
+	return features;
+}
+
+//built-in byte traits of 4 byte scalars: digit k is byte k of the key bits xor a constant mask, and for floats the magnitude mask
+template <typename Trait, typename Iter>
+concept radix_simd_countable = bool(RADIX_SORT_X86_64) && std::contiguous_iterator<Iter> && std::endian::native == std::endian::little
+	&& sizeof(std::iter_value_t<Iter>) == 4
+	&& (std::is_arithmetic_v<std::iter_value_t<Iter>> || std::is_pointer_v<std::iter_value_t<Iter>>)
+	&& (std::is_same_v<radix_base_trait_t<Trait>, radix_trait<std::iter_value_t<Iter>>> || std::is_same_v<radix_base_trait_t<Trait>, radix_trait_greater<std::iter_value_t<Iter>>>);
+
+template <typename Trait, typename T, size_t... i>
+std::uint64_t radix_digit_mask(std::index_sequence<i...>) noexcept
+{
+	const T zero{};
+	return ((static_cast<std::uint64_t>(Trait::template get<i>(zero)) << (i * CHAR_BIT)) | ...);
+}
+
+#if RADIX_SORT_X86_64
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized" //gcc 12 avx512 headers pass _mm512_undefined to every unmasked intrinsic
+#endif
+//every lane increments its own padded bank with gather/scatter, so repeated keys never serialize on one counter
+template <typename T, size_t radix_size, typename cnt_type>
+RADIX_SORT_TARGET("avx512f") void count_all_avx512(const T* begin, const T* end, std::uint64_t mask, std::array<std::array<cnt_type, 256>, radix_size>& counter)
+{
+	constexpr size_t lane_num = 16, bank_pad = 272; //pad banks so lanes do not alias the same cache set
+	constexpr size_t block_length = size_t(1) << 31; //a lane bank never overflows its 32-bit counters
+	alignas(64) std::uint32_t bank[radix_size][lane_num * bank_pad];
+	memset(counter.data(), 0, sizeof(counter));
+	while (end - begin >= static_cast<std::ptrdiff_t>(lane_num))
+	{
+		memset(bank, 0, sizeof(bank));
+		auto block_end = begin + std::min<size_t>(block_length, (end - begin) / lane_num * lane_num);
+		const __m512i lane = _mm512_mullo_epi32(_mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15), _mm512_set1_epi32(bank_pad));
+		const __m512i xor_mask = _mm512_set1_epi32(static_cast<int>(mask)), ff = _mm512_set1_epi32(0xff), one = _mm512_set1_epi32(1);
+		for (; begin != block_end; begin += lane_num)
+		{
+			__m512i bits = _mm512_loadu_si512(begin);
+			__m512i key = _mm512_xor_si512(bits, xor_mask);
+			if constexpr (std::is_floating_point_v<T>)
+				key = _mm512_xor_si512(key, _mm512_srli_epi32(_mm512_srai_epi32(bits, 31), 1));
+			for (size_t d = 0; d < radix_size; ++d)
+			{
+				__m512i idx = _mm512_add_epi32(_mm512_and_si512(_mm512_srli_epi32(key, static_cast<unsigned int>(d * 8)), ff), lane);
+				_mm512_i32scatter_epi32(bank[d], idx, _mm512_add_epi32(_mm512_i32gather_epi32(idx, bank[d], 4), one), 4);
+			}
+		}
+		for (size_t d = 0; d < radix_size; ++d)
+			for (size_t l = 0; l < lane_num; ++l)
+				for (size_t k = 0; k < 256; ++k)
+					counter[d][k] += bank[d][l * bank_pad + k];
+	}
+	for (; begin != end; ++begin)
+	{
+		auto key = radix_key_bits(*begin) ^ mask ^ radix_magnitude_mask<T>(radix_key_bits(*begin));
+		for (size_t d = 0; d < radix_size; ++d)
+			++counter[d][(key >> (d * 8)) & 0xff];
+	}
+}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#endif
+
+template<size_t i, typename Trait, typename Iter, typename cnt_type>
+void count_duff_device(Iter begin, Iter end, radix_counter<Trait, cnt_type>& counter0, radix_counter<Trait, cnt_type>& counter1, radix_counter<Trait, cnt_type>& counter2, radix_counter<Trait, cnt_type>& counter3)
+{
+	auto length = std::distance(begin, end);
+	if (length == 0)
+		return;
+	//We should take care of iterator to avoid it out range of [begin,end], or we may face assertion in debug mode
+	auto diff = (length % 4 + 3) % 4;
+	begin += diff;
+	end -= 1;
+	switch (diff) //Dear duff device
+	{
+		for (;; begin += 4)
+		{
+	[[fallthrough]]; case 3:++counter3[Trait::template get<i>(*(begin - 3))];
+	[[fallthrough]]; case 2:++counter2[Trait::template get<i>(*(begin - 2))];
+	[[fallthrough]]; case 1:++counter1[Trait::template get<i>(*(begin - 1))];
+	[[fallthrough]]; case 0:++counter0[Trait::template get<i>(*begin)];
+							if (begin == end) [[unlikely]]
+								break;
+		}
+	};
+}
+
+template<size_t i, typename Trait, typename Iter, typename cnt_type>
+void count_duff_device(Iter begin, Iter end, radix_counter<Trait, cnt_type>& counter)
+{
+	constexpr auto bank_length_limit = 4096; //below this zeroing and merging the banks costs more than it saves
+	memset(counter.data(), 0, sizeof(counter));
+	if constexpr (radix_digit_bits_v<Trait> <= CHAR_BIT)
+	{
+		//neighbouring elements go to different banks, so runs of equal digits do not wait on the same counter
+		if (std::distance(begin, end) >= bank_length_limit)
+		{
+			radix_counter<Trait, cnt_type> bank1{}, bank2{}, bank3{};
+			count_duff_device<i, Trait>(begin, end, counter, bank1, bank2, bank3);
+			for (size_t k = 0; k < radix_bucket_num_v<Trait>; ++k)
+				counter[k] += bank1[k] + bank2[k] + bank3[k];
+			return;
+		}
+	}
+	count_duff_device<i, Trait>(begin, end, counter, counter, counter, counter);
+}
+
+template<typename Trait, typename T, typename cnt_type, size_t... i>
+inline void count_all_digits(const T& obj, radix_histograms<Trait, cnt_type>& counter, std::index_sequence<i...>)
+{
+	(++counter[i][Trait::template get<i>(obj)], ...);
+}
+
+template<typename Trait, typename Iter, typename Counter0, typename Counter1, typename Counter2, typename Counter3>
+void count_all_duff_device(Iter begin, Iter end, Counter0& counter0, Counter1& counter1, Counter2& counter2, Counter3& counter3)
+{
+	using seq = std::make_index_sequence<Trait::radix_size>;
+	auto length = std::distance(begin, end);
+	if (length == 0)
+		return;
+	auto diff = (length % 4 + 3) % 4;
+	begin += diff;
+	end -= 1;
+	switch (diff)
+	{
+		for (;; begin += 4)
+		{
+	[[fallthrough]]; case 3:count_all_digits<Trait>(*(begin - 3), counter3, seq{});
+	[[fallthrough]]; case 2:count_all_digits<Trait>(*(begin - 2), counter2, seq{});
+	[[fallthrough]]; case 1:count_all_digits<Trait>(*(begin - 1), counter1, seq{});
+	[[fallthrough]]; case 0:count_all_digits<Trait>(*begin, counter0, seq{});
+							if (begin == end) [[unlikely]]
+								break;
+		}
+	};
+}
+
+//build the histograms of every digit with a single read of [begin,end)
+template<typename Trait, typename Iter, typename cnt_type>
+void count_all_duff_device(Iter begin, Iter end, radix_histograms<Trait, cnt_type>& counter)
+{
+	using seq = std::make_index_sequence<Trait::radix_size>;
+	constexpr auto simd_length_limit = 4096, bank_length_limit = 4096;
+	auto length = std::distance(begin, end);
+#if RADIX_SORT_X86_64
+	if constexpr (radix_simd_countable<Trait, Iter>)
+	{
+		if (length >= simd_length_limit && radix_cpu().avx512f)
+		{
+			static const auto mask = radix_digit_mask<Trait, std::iter_value_t<Iter>>(seq{});
+			count_all_avx512(std::to_address(begin), std::to_address(end), mask, counter);
+			return;
+		}
+	}
+#endif
+	memset(counter.data(), 0, sizeof(counter));
+	if constexpr (radix_digit_bits_v<Trait> <= CHAR_BIT)
+	{
+		//neighbouring elements go to different banks as in count_duff_device. 32-bit banks keep the four of them
+		//within L1 for 8 byte keys, blocks of 2^31 elements keep them from overflowing
+		if (length >= bank_length_limit)
+		{
+			constexpr std::ptrdiff_t block_length = std::ptrdiff_t(1) << 31;
+			radix_histograms<Trait, std::uint32_t> bank[4];
+			while (length > 0)
+			{
+				auto block = std::min(length, block_length);
+				auto block_end = std::next(begin, block);
+				memset(bank, 0, sizeof(bank));
+				count_all_duff_device<Trait>(begin, block_end, bank[0], bank[1], bank[2], bank[3]);
+				for (size_t d = 0; d < Trait::radix_size; ++d)
+					for (size_t k = 0; k < radix_bucket_num_v<Trait>; ++k)
+						counter[d][k] += bank[0][d][k] + bank[1][d][k] + bank[2][d][k] + bank[3][d][k];
+				begin = block_end;
+				length -= block;
+			}
+			return;
+		}
+	}
+	count_all_duff_device<Trait>(begin, end, counter, counter, counter, counter);
+}
+
+template<size_t i, typename Trait, typename SrcIter, typename DstIter, typename cnt_type>
+void place_duff_device(SrcIter src, DstIter dst, radix_counter<Trait, cnt_type>& counter, size_t pos_beg, size_t pos_end)
+{
+	src += pos_beg;
+	std::ptrdiff_t j_raw = pos_end - pos_beg, j = j_raw - (j_raw % 4);
+	radix_digit_t<radix_digit_bits_v<Trait>> t0, t1, t2, t3;
+	switch (j_raw % 4)
+	{
+		for (; j >= 0; j -= 4)
+		{
+			t3 = Trait::template get<i>(src[j + 3]);
+			dst[--counter[t3]] = std::move(src[j + 3]);
+	[[fallthrough]]; case 3:	t2 = Trait::template get<i>(src[j + 2]);
+		dst[--counter[t2]] = std::move(src[j + 2]);
+	[[fallthrough]]; case 2:	t1 = Trait::template get<i>(src[j + 1]);
+		dst[--counter[t1]] = std::move(src[j + 1]);
+	[[fallthrough]]; case 1:	t0 = Trait::template get<i>(src[j]);
+		dst[--counter[t0]] = std::move(src[j]);
+	[[fallthrough]]; case 0:;
+		}
+	}
+}
+
+//elements that may be moved by memcpy between contiguous ranges can be staged and written a cache line at a time,
+//std::pair of scalars qualifies although its assignment operator keeps it from being trivially copyable
+template <typename SrcIter, typename DstIter>
+concept radix_write_combinable = std::contiguous_iterator<SrcIter> && std::contiguous_iterator<DstIter>
+	&& std::is_same_v<std::iter_value_t<SrcIter>, std::iter_value_t<DstIter>>
+	&& std::is_trivially_copy_constructible_v<std::iter_value_t<DstIter>> && std::is_trivially_destructible_v<std::iter_value_t<DstIter>>
+	&& 64 % sizeof(std::iter_value_t<DstIter>) == 0;
+
+//copy one staged 64 byte line to an aligned destination without pulling the line into cache
+inline void radix_stream_line(void* dst, const void* src) noexcept
+{
+#if RADIX_SORT_X86_64
+	for (auto k = 0; k < 4; ++k)
+		_mm_stream_si128(static_cast<__m128i*>(dst) + k, _mm_load_si128(static_cast<const __m128i*>(src) + k));
+#else
+	memcpy(dst, src, 64);
+#endif
+}
+
+inline void radix_stream_fence() noexcept
+{
+#if RADIX_SORT_X86_64
+	_mm_sfence();
+#endif
+}
+
+//same result as place_duff_device, but every bucket collects its elements in a cache line sized stage
+//and only complete lines reach dst, so 256 open destinations cost 256 lines instead of 256 pages.
+//dst must be aligned to sizeof(T), partial lines at bucket and chunk borders use ordinary stores
+template<size_t i, typename Trait, typename KeyIter, typename T, typename cnt_type>
+void place_write_combined(KeyIter key, const T* src, T* dst, radix_counter<Trait, cnt_type>& counter, size_t pos_beg, size_t pos_end)
+{
+	using namespace std;
+	constexpr size_t line_length = 64 / sizeof(T);
+	alignas(64) unsigned char stage[radix_bucket_num_v<Trait>][64];
+	auto line_end = counter; //end of the not yet written part of each bucket's current line
+	auto out = reinterpret_cast<unsigned char*>(dst);
+	auto line_base = reinterpret_cast<uintptr_t>(dst) / sizeof(T);
+	for (auto j = pos_end; j-- > pos_beg;)
+	{
+		auto t = Trait::template get<i>(key[j]);
+		size_t pos = --counter[t], slot = (line_base + pos) % line_length;
+		memcpy(stage[t] + slot * sizeof(T), src + j, sizeof(T));
+		if (slot == 0)
+		{
+			if (line_end[t] - pos == line_length)
+				radix_stream_line(out + pos * sizeof(T), stage[t]);
+			else
+				memcpy(out + pos * sizeof(T), stage[t], (line_end[t] - pos) * sizeof(T));
+			line_end[t] = pos;
+		}
+	}
+	for (size_t b = 0; b < radix_bucket_num_v<Trait>; ++b)
+		if (line_end[b] != counter[b])
+			memcpy(out + counter[b] * sizeof(T), stage[b] + (line_base + counter[b]) % line_length * sizeof(T), (line_end[b] - counter[b]) * sizeof(T));
+	radix_stream_fence();
+}
+
+//whether a pass over a sort of length elements should stage its writes: only once one pass outgrows the cache
+template <typename Trait, typename SrcIter, typename DstIter>
+bool radix_write_combine(DstIter dst, size_t length) noexcept
+{
+	using value_type = std::iter_value_t<DstIter>;
+	constexpr size_t write_combine_size_limit = size_t(1) << 22; //bytes of one pass, below this the plain scatter keeps up
+	if constexpr (radix_write_combinable<SrcIter, DstIter> && radix_digit_bits_v<Trait> <= 11)
+		return length * sizeof(value_type) >= write_combine_size_limit && reinterpret_cast<uintptr_t>(std::to_address(dst)) % sizeof(value_type) == 0;
+	else
+		return false;
+}
+
+//scatter [pos_beg,pos_end) of src into dst, length is the size of the whole sort
+template<size_t i, typename Trait, typename SrcIter, typename DstIter, typename cnt_type>
+void radix_place(SrcIter src, DstIter dst, radix_counter<Trait, cnt_type>& counter, size_t pos_beg, size_t pos_end, size_t length)
+{
+	if constexpr (radix_write_combinable<SrcIter, DstIter>)
+		if (radix_write_combine<Trait, SrcIter>(dst, length))
+			return place_write_combined<i, Trait>(std::to_address(src), std::to_address(src), std::to_address(dst), counter, pos_beg, pos_end);
+	place_duff_device<i, Trait>(src, dst, counter, pos_beg, pos_end);
+}
+
+//radix_place for a column that follows the digits of another range, key[j] decides where src[j] goes
+template<size_t i, typename Trait, typename KeyIter, typename SrcIter, typename DstIter, typename cnt_type>
+void radix_place_column(KeyIter key, SrcIter src, DstIter dst, radix_counter<Trait, cnt_type>& counter, size_t pos_beg, size_t pos_end, size_t length)
+{
+	if constexpr (radix_write_combinable<SrcIter, DstIter>)
+		if (radix_write_combine<Trait, SrcIter>(dst, length))
+			return place_write_combined<i, Trait>(key, std::to_address(src), std::to_address(dst), counter, pos_beg, pos_end);
+	for (auto j = pos_end; j-- > pos_beg;)
+		dst[--counter[Trait::template get<i>(key[j])]] = std::move(src[j]);
+}
+
+//all elements share the i-th digit, so the pass would only copy them
+template<size_t i, typename Trait, typename Iter, typename cnt_type>
+bool is_trivial_pass(Iter first, std::ptrdiff_t length, const radix_counter<Trait, cnt_type>& counter)
+{
+	return length == 0 || counter[Trait::template get<i>(*first)] == length;
+}
+
+//stop request of the LSD sorts. they ask requested() only where a true answer makes them skip work,
+//so stopped tells whether the range was left unsorted, not merely whether a stop came at some point
+struct radix_stop
+{
+	std::stop_token token;
+	mutable std::atomic<bool> stopped = false;
+
+	bool requested() const noexcept
+	{
+		if (!token.stop_requested())
+			return false;
+		stopped.store(true, std::memory_order_relaxed);
+		return true;
+	}
+};
+
+template <size_t i, typename Trait, typename Iter, typename cnt_type>
+void radix_sort_impl(Iter first, Iter second, typename std::iterator_traits<Iter>::value_type* buffer, radix_histograms<Trait, cnt_type>& counter, bool in_buffer = false, const radix_stop& stop = {})
+{
+	using namespace std;
+	constexpr auto radix_size = Trait::radix_size;
+	auto length = distance(first, second);
+
+	//in_buffer at i == 0 means the elements start out in buffer and end up in [first,second)
+	if constexpr (i == 0)
+	{
+		auto beg = radix_instrument_now<Trait>();
+		if (in_buffer)
+			count_all_duff_device<Trait>(buffer, buffer + length, counter);
+		else
+			count_all_duff_device<Trait>(first, second, counter);
+		radix_report_count<Trait>(length, beg);
+	}
+	if constexpr (i < radix_size)
+	{
+		if (in_buffer ? !is_trivial_pass<i, Trait>(buffer, length, counter[i]) : !is_trivial_pass<i, Trait>(first, length, counter[i]))
+		{
+			auto beg = radix_instrument_now<Trait>();
+			auto pass = radix_pass_stats<i, Trait>(counter[i], false, length);
+			for (size_t j = 1; j < radix_bucket_num_v<Trait>; ++j)
+				counter[i][j] += counter[i][j - 1];
+			if (in_buffer)
+				radix_place<i, Trait>(buffer, first, counter[i], 0, length, length);
+			else
+				radix_place<i, Trait>(first, buffer, counter[i], 0, length, length);
+			in_buffer = !in_buffer;
+			radix_report_pass<Trait>(pass, length * sizeof(*buffer), beg);
+		}
+		else
+			radix_report_skipped<i, Trait>(length);
+	}
+	//a stop request skips the remaining passes, the elements still end up in [first,second)
+	if constexpr (i + 1 < radix_size)
+		if (!stop.requested())
+			return radix_sort_impl<i + 1, Trait, Iter>(first, second, buffer, counter, in_buffer, stop);
+	if (in_buffer)
+	{
+		auto beg = radix_instrument_now<Trait>();
+		std::move(buffer, buffer + length, first);
+		radix_report_copy<Trait>(length, length * sizeof(*buffer), beg);
+	}
+}
+
+template <typename Trait, typename cnt_type>
+struct radix_chunk_counter
+{
+	radix_histograms<Trait, cnt_type> histogram;
+	radix_counter<Trait, cnt_type> offset; //scatter positions of the chunk for the current digit
+};
+
+//counter[j].histogram[i][k] becomes the number of k in chunks j..chunk_num-1,
+//so counter[0].histogram[i] turns into the inclusive prefix sum of the whole range
+template <size_t i, typename Trait, typename cnt_type>
+void merge_chunk_histograms(radix_thread_pool& pool, unsigned int thrd_lim, unsigned int chunk_num, radix_chunk_counter<Trait, cnt_type>* counter)
+{
+	constexpr size_t merge_block = radix_bucket_num_v<Trait> / 16; //buckets per prefix-merge task
+	radix_parallel_for<Trait>(pool, radix_bucket_num_v<Trait> / merge_block, [&](size_t blk) {
+		for (int j = chunk_num - 2; j >= 0; --j)
+			for (size_t k = blk * merge_block; k < (blk + 1) * merge_block; ++k)
+				counter[j].histogram[i][k] += counter[j + 1].histogram[i][k];
+	}, thrd_lim, radix_phase::prefix, i);
+	for (size_t j = 1; j < radix_bucket_num_v<Trait>; ++j)
+		counter[0].histogram[i][j] += counter[0].histogram[i][j - 1];
+}
+
+//scatter positions of chunk j for digit i, after merge_chunk_histograms
+template <size_t i, typename Trait, typename cnt_type>
+radix_counter<Trait, cnt_type>& chunk_offset(radix_chunk_counter<Trait, cnt_type>* counter, unsigned int chunk_num, size_t j)
+{
+	auto& cnt = counter[j].offset;
+	for (size_t k = 0; k < radix_bucket_num_v<Trait>; ++k)
+		cnt[k] = counter[0].histogram[i][k] - (j != chunk_num - 1 ? counter[j + 1].histogram[i][k] : 0);
+	return cnt;
+}
+
+template <size_t i, typename Iter, typename Trait, typename cnt_type>
+void parallel_radix_sort_impl(Iter first, Iter second, radix_thread_pool& pool, unsigned int thrd_lim, unsigned int chunk_num, typename std::iterator_traits<Iter>::value_type* buffer, radix_chunk_counter<Trait, cnt_type>* counter, bool in_buffer = false, bool permuted = false, const radix_stop& stop = {})
+{
+	using namespace std;
+	constexpr auto radix_size = Trait::radix_size;
+	auto length = distance(first, second), parallel_width = length / chunk_num;
+	auto chunk_end = [&](size_t j) { return j == chunk_num - 1 ? length : (j + 1) * parallel_width; };
+
+	if constexpr (i == 0)
+	{
+		auto beg = radix_instrument_now<Trait>();
+		radix_parallel_for<Trait>(pool, chunk_num, [&](size_t j) {
+			if (in_buffer)
+				count_all_duff_device<Trait>(buffer + j * parallel_width, buffer + chunk_end(j), counter[j].histogram);
+			else
+				count_all_duff_device<Trait>(first + j * parallel_width, first + chunk_end(j), counter[j].histogram);
+		}, thrd_lim, radix_phase::count);
+		radix_report_count<Trait>(length, beg);
+	}
+	if constexpr (i < radix_size)
+	{
+		cnt_type total = 0;
+		auto digit = in_buffer ? Trait::template get<i>(*buffer) : Trait::template get<i>(*first);
+		for (auto j = 0u; j < chunk_num; ++j)
+			total += counter[j].histogram[i][digit];
+		if (total != length)
+		{
+			auto beg = radix_instrument_now<Trait>();
+			//the single-read histograms only describe each chunk before the first real scatter
+			if (permuted)
+				radix_parallel_for<Trait>(pool, chunk_num, [&](size_t j) {
+					if (in_buffer)
+						count_duff_device<i, Trait>(buffer + j * parallel_width, buffer + chunk_end(j), counter[j].histogram[i]);
+					else
+						count_duff_device<i, Trait>(first + j * parallel_width, first + chunk_end(j), counter[j].histogram[i]);
+				}, thrd_lim, radix_phase::count, i);
+
+			merge_chunk_histograms<i>(pool, thrd_lim, chunk_num, counter);
+			auto pass = radix_pass_stats<i, Trait>(counter[0].histogram[i], true, length);
+			radix_parallel_for<Trait>(pool, chunk_num, [&](size_t j) {
+				auto& cnt = chunk_offset<i>(counter, chunk_num, j);
+				if (in_buffer)
+					radix_place<i, Trait>(buffer, first, cnt, j * parallel_width, chunk_end(j), length);
+				else
+					radix_place<i, Trait>(first, buffer, cnt, j * parallel_width, chunk_end(j), length);
+			}, thrd_lim, radix_phase::scatter, i);
+			radix_report_pass<Trait>(pass, length * sizeof(*buffer), beg);
+			in_buffer = !in_buffer;
+			permuted = true;
+		}
+		else
+			radix_report_skipped<i, Trait>(length);
+	}
+	if constexpr (i + 1 < radix_size)
+		if (!stop.requested())
+			return parallel_radix_sort_impl<i + 1, Iter, Trait>(first, second, pool, thrd_lim, chunk_num, buffer, counter, in_buffer, permuted, stop);
+	if (in_buffer)
+	{
+		auto beg = radix_instrument_now<Trait>();
+		radix_parallel_for<Trait>(pool, chunk_num, [&](size_t j) {
+			std::move(buffer + j * parallel_width, buffer + chunk_end(j), first + j * parallel_width);
+		}, thrd_lim, radix_phase::copy);
+		radix_report_copy<Trait>(length, length * sizeof(*buffer), beg);
+	}
+}
+
+//hybrid parallel sort: one parallel MSD pass moves every element into its top digit bucket in buffer, then every bucket
+//is sorted on the remaining digits by a single thread with radix_sort_impl back into [first,second) while it is cache resident.
+//buckets too big to balance are sorted by every thread instead. returns false, having read nothing but a sample, when
+//the sample shares one top digit: the LSD sort skips a trivial top digit at no extra cost, counting it here first would
+//read the range once more. counter holds chunk_num + thrd_lim entries, the last ones are the histograms of the bucket tasks.
+//after a stop request the buckets not sorted yet are only moved back
+template <typename Trait, typename Iter, typename cnt_type>
+bool parallel_hybrid_radix_sort_impl(Iter first, Iter second, radix_thread_pool& pool, unsigned int thrd_lim, unsigned int chunk_num, typename std::iterator_traits<Iter>::value_type* buffer, radix_chunk_counter<Trait, cnt_type>* counter, const radix_stop& stop = {})
+{
+	using namespace std;
+	constexpr auto top = Trait::radix_size - 1;
+	constexpr auto bucket_num = radix_bucket_num_v<Trait>;
+	auto length = distance(first, second), parallel_width = length / chunk_num;
+	auto chunk_end = [&](size_t j) { return j == chunk_num - 1 ? length : (j + 1) * parallel_width; };
+
+	constexpr size_t sample_num = 64;
+	bool split = false;
+	for (size_t k = 1; k < sample_num && !split; ++k)
+		split = Trait::template get<top>(first[(length - 1) * k / (sample_num - 1)]) != Trait::template get<top>(*first);
+	if (!split)
+		return false;
+	auto beg = radix_instrument_now<Trait>();
+	radix_parallel_for<Trait>(pool, chunk_num, [&](size_t j) {
+		count_duff_device<top, Trait>(first + j * parallel_width, first + chunk_end(j), counter[j].histogram[top]);
+	}, thrd_lim, radix_phase::count, top);
+	radix_report_count<Trait>(length, beg);
+	merge_chunk_histograms<top>(pool, thrd_lim, chunk_num, counter);
+	auto bucket_end = counter[0].histogram[top]; //a copy, big buckets reuse counter
+	auto bucket_beg = [&](size_t b) { return b ? bucket_end[b - 1] : cnt_type(0); };
+	auto bucket_size = [&](size_t b) { return bucket_end[b] - bucket_beg(b); };
+	beg = radix_instrument_now<Trait>();
+	auto pass = radix_pass_stats<top, Trait>(bucket_end, true, length);
+	radix_parallel_for<Trait>(pool, chunk_num, [&](size_t j) {
+		radix_place<top, Trait>(first, buffer, chunk_offset<top>(counter, chunk_num, j), j * parallel_width, chunk_end(j), length);
+	}, thrd_lim, radix_phase::scatter, top);
+	radix_report_pass<Trait>(pass, length * sizeof(*buffer), beg);
+
+	//largest buckets first, so the tasks left at the end of the parallel_for are short
+	array<unsigned int, bucket_num> order;
+	unsigned int order_num = 0, big_num = 0;
+	for (unsigned int b = 0; b < bucket_num; ++b)
+		if (bucket_size(b) > 1)
+			order[order_num++] = b;
+	sort(order.begin(), order.begin() + order_num, [&](auto x, auto y) { return bucket_size(x) > bucket_size(y); });
+	for (; big_num < order_num && bucket_size(order[big_num]) * thrd_lim > length; ++big_num)
+	{
+		auto b = order[big_num];
+		parallel_radix_sort_impl<0, Iter, Trait>(first + bucket_beg(b), first + bucket_end[b], pool, thrd_lim, chunk_num, buffer + bucket_beg(b), counter, true, false, stop);
+	}
+	radix_parallel_for<Trait>(pool, order_num - big_num, [&](size_t k) {
+		auto b = order[big_num + k];
+		if (stop.requested())
+			std::move(buffer + bucket_beg(b), buffer + bucket_end[b], first + bucket_beg(b));
+		else
+			radix_sort_impl<0, Trait, Iter>(first + bucket_beg(b), first + bucket_end[b], buffer + bucket_beg(b), counter[chunk_num + radix_thread_pool::participant()].histogram, true, stop);
+	}, thrd_lim, radix_phase::buckets, top);
+	//buckets of one element were only moved to buffer
+	for (unsigned int b = 0; b < bucket_num; ++b)
+		if (bucket_size(b) == 1)
+			first[bucket_beg(b)] = std::move(buffer[bucket_beg(b)]);
+	return true;
+}
+
+//traits of variable-length keys give the key bytes of an element instead of a fixed number of digits,
+//such keys are sorted most significant byte first with a sentinel bucket for keys that end
+template <typename Trait, typename T>
+concept radix_string_trait = requires(const T & obj)
+{
+	{ Trait::key(obj) } -> std::convertible_to<std::span<const unsigned char>>;
+};
+
+//an element's key while sorting: the next 8 key bytes are cached big-endian, so 8 levels of buckets need one trip to data
+struct radix_string_ref
+{
+	std::uint64_t cache;
+	const unsigned char* data;
+	size_t length;
+	size_t index;
+};
+
+inline std::uint64_t radix_string_cache(const unsigned char* data, size_t length, size_t depth) noexcept
+{
+	std::uint64_t cache = 0;
+	for (size_t d = depth; d < depth + 8; ++d)
+		cache = cache << 8 | (d < length ? data[d] : 0u);
+	return cache;
+}
+
+//bucket of a key at depth: 0 once the key has ended, 1 + byte otherwise, read from a cache loaded at depth / 8 * 8
+inline unsigned int radix_string_digit(const radix_string_ref& s, size_t depth) noexcept
+{
+	return depth < s.length ? static_cast<unsigned int>(s.cache >> (56 - depth % 8 * 8) & 0xff) + 1 : 0;
+}
+
+//keys of equal prefix [0,depth) in lexicographic order, equal keys in input order
+inline bool radix_string_less(const radix_string_ref& a, const radix_string_ref& b, size_t depth) noexcept
+{
+	auto length = std::min(a.length, b.length);
+	if (depth < length)
+		if (auto c = memcmp(a.data + depth, b.data + depth, length - depth))
+			return c < 0;
+	return a.length != b.length ? a.length < b.length : a.index < b.index;
+}
+
+inline void radix_string_insertion_sort(radix_string_ref* ref, size_t length, size_t depth) noexcept
+{
+	for (size_t j = 1; j < length; ++j)
+	{
+		auto obj = ref[j];
+		auto k = j;
+		for (; k > 0 && radix_string_less(obj, ref[k - 1], depth); --k)
+			ref[k] = ref[k - 1];
+		ref[k] = obj;
+	}
+}
+
+inline void radix_string_sort_impl(radix_string_ref* ref, radix_string_ref* buffer, size_t length, size_t depth);
+
+inline void radix_string_reload(radix_string_ref* ref, size_t pos_beg, size_t pos_end, size_t depth) noexcept
+{
+	if (depth % 8 == 0)
+		for (auto j = pos_beg; j < pos_end; ++j)
+			ref[j].cache = radix_string_cache(ref[j].data, ref[j].length, depth);
+}
+
+//sort a bucket whose keys share [0,depth), reloading the caches when depth leaves them
+inline void radix_string_descend(radix_string_ref* ref, radix_string_ref* buffer, size_t length, size_t depth)
+{
+	if (length < 2)
+		return;
+	radix_string_reload(ref, 0, length, depth);
+	radix_string_sort_impl(ref, buffer, length, depth);
+}
+
+//multikey quicksort: three-way partition on the digit at depth, only the equal part moves on to depth + 1
+inline void radix_string_multikey_sort(radix_string_ref* ref, radix_string_ref* buffer, size_t length, size_t depth)
+{
+	constexpr size_t insertion_sort_length_limit = 16;
+	while (length > insertion_sort_length_limit)
+	{
+		unsigned int a = radix_string_digit(ref[0], depth), b = radix_string_digit(ref[length / 2], depth), c = radix_string_digit(ref[length - 1], depth);
+		auto pivot = std::max(std::min(a, b), std::min(std::max(a, b), c));
+		size_t lt = 0, gt = length;
+		for (size_t j = 0; j < gt;)
+		{
+			auto d = radix_string_digit(ref[j], depth);
+			if (d < pivot)
+				std::swap(ref[lt++], ref[j++]);
+			else if (d > pivot)
+				std::swap(ref[j], ref[--gt]);
+			else
+				++j;
+		}
+		if (lt == 0 && gt == length && pivot != 0) //a common byte, go on with the next one
+		{
+			radix_string_reload(ref, 0, length, ++depth);
+			continue;
+		}
+		radix_string_multikey_sort(ref, buffer, lt, depth);
+		if (pivot == 0) //keys that ended are equal, restore their input order
+			std::sort(ref + lt, ref + gt, [](const auto& x, const auto& y) { return x.index < y.index; });
+		else
+			radix_string_descend(ref + lt, buffer + lt, gt - lt, depth + 1);
+		ref += gt;
+		buffer += gt;
+		length -= gt;
+	}
+	radix_string_insertion_sort(ref, length, depth);
+}
+
+//counting pass on the digit at depth: stable, so keys that end (bucket 0) stay in input order
+inline void radix_string_sort_impl(radix_string_ref* ref, radix_string_ref* buffer, size_t length, size_t depth)
+{
+	constexpr size_t multikey_sort_length_limit = 256; //below this a 257 bucket pass costs more than it saves
+	std::array<size_t, 257> counter, pos;
+	for (;; radix_string_reload(ref, 0, length, ++depth))
+	{
+		if (length <= multikey_sort_length_limit)
+			return radix_string_multikey_sort(ref, buffer, length, depth);
+		counter.fill(0);
+		for (size_t j = 0; j < length; ++j)
+			++counter[radix_string_digit(ref[j], depth)];
+		auto digit = radix_string_digit(ref[0], depth);
+		if (counter[digit] != length)
+			break;
+		if (digit == 0)
+			return;
+	}
+	pos[0] = 0;
+	for (size_t b = 1; b < 257; ++b)
+		pos[b] = pos[b - 1] + counter[b - 1];
+	for (size_t j = 0; j < length; ++j)
+		buffer[pos[radix_string_digit(ref[j], depth)]++] = ref[j];
+	std::copy(buffer, buffer + length, ref);
+	for (size_t b = 1; b < 257; ++b)
+		radix_string_descend(ref + pos[b - 1], buffer + pos[b - 1], counter[b], depth + 1);
+}
+
+//split on the digit at depth with every thread, big buckets split again, the rest are sorted one per task
+inline void parallel_radix_string_sort_impl(radix_string_ref* ref, radix_string_ref* buffer, size_t length, size_t depth, radix_thread_pool& pool, unsigned int thrd_lim, std::array<size_t, 257>* counter)
+{
+	using namespace std;
+	constexpr size_t parallel_length_limit = 1 << 16; //smaller buckets are not worth splitting across threads
+	if (length < parallel_length_limit)
+		return radix_string_descend(ref, buffer, length, depth);
+	auto chunk_beg = [&](size_t j) { return length * j / thrd_lim; };
+	array<size_t, 257> bucket_beg, bucket_size;
+	for (;; ++depth)
+	{
+		if (depth % 8 == 0)
+			pool.parallel_for(thrd_lim, [&](size_t j) { radix_string_reload(ref, chunk_beg(j), chunk_beg(j + 1), depth); }, thrd_lim);
+		pool.parallel_for(thrd_lim, [&](size_t j) {
+			counter[j].fill(0);
+			for (auto k = chunk_beg(j); k < chunk_beg(j + 1); ++k)
+				++counter[j][radix_string_digit(ref[k], depth)];
+		}, thrd_lim);
+		bucket_size.fill(0);
+		for (size_t b = 0, pos = 0; b < 257; ++b)
+		{
+			bucket_beg[b] = pos;
+			for (auto j = 0u; j < thrd_lim; ++j)
+			{
+				bucket_size[b] += counter[j][b];
+				pos += exchange(counter[j][b], pos); //counter[j][b] becomes chunk j's first position in bucket b
+			}
+		}
+		auto digit = radix_string_digit(ref[0], depth);
+		if (bucket_size[digit] != length)
+			break;
+		if (digit == 0)
+			return;
+	}
+	pool.parallel_for(thrd_lim, [&](size_t j) {
+		for (auto k = chunk_beg(j); k < chunk_beg(j + 1); ++k)
+			buffer[counter[j][radix_string_digit(ref[k], depth)]++] = ref[k];
+	}, thrd_lim);
+	pool.parallel_for(thrd_lim, [&](size_t j) {
+		copy(buffer + chunk_beg(j), buffer + chunk_beg(j + 1), ref + chunk_beg(j));
+	}, thrd_lim);
+
+	array<unsigned int, 256> order;
+	for (unsigned int b = 0; b < 256; ++b)
+		order[b] = b + 1;
+	sort(order.begin(), order.end(), [&](auto x, auto y) { return bucket_size[x] > bucket_size[y]; });
+	size_t next = 0;
+	for (; next < 256 && bucket_size[order[next]] * thrd_lim > length; ++next)
+	{
+		auto b = order[next];
+		parallel_radix_string_sort_impl(ref + bucket_beg[b], buffer + bucket_beg[b], bucket_size[b], depth + 1, pool, thrd_lim, counter);
+	}
+	pool.parallel_for(256 - next, [&](size_t k) {
+		auto b = order[next + k];
+		radix_string_descend(ref + bucket_beg[b], buffer + bucket_beg[b], bucket_size[b], depth + 1);
+	}, thrd_lim);
+}
+
+//move every element once so that first[k] becomes the element at key[k].index, key[k].index is overwritten
+template <typename Iter, typename Key>
+void radix_permute_by_index(Iter first, Key* key, size_t length)
+{
+	for (size_t s = 0; s < length; ++s)
+	{
+		if (key[s].index == s)
+			continue;
+		auto tmp = std::move(first[s]);
+		size_t k = s;
+		for (size_t next; (next = key[k].index) != s; k = next)
+		{
+			first[k] = std::move(first[next]);
+			key[k].index = k;
+		}
+		first[k] = std::move(tmp);
+		key[k].index = k;
+	}
+}
+
+//sort references to the keys, then move each element once, the permutation pass is serial
+template <typename Trait, bool parallel, typename Iter>
+void string_radix_sort_impl(Iter first, Iter second, radix_sort_context& ctx)
+{
+	using namespace std;
+	size_t length = distance(first, second);
+	if (length < 2)
+		return;
+	auto ref = ctx.buffer<radix_string_ref>(2 * length);
+	auto thrd_lim = parallel ? ctx.thread_num(length) : 1u;
+	auto fill = [&](size_t pos_beg, size_t pos_end) {
+		for (auto j = pos_beg; j < pos_end; ++j)
+		{
+			span<const unsigned char> key = Trait::key(first[j]);
+			ref[j] = { 0, key.data(), key.size(), j };
+		}
+	};
+	if (thrd_lim > 1)
+	{
+		auto& pool = ctx.thread_pool();
+		pool.parallel_for(thrd_lim, [&](size_t j) { fill(length * j / thrd_lim, length * (j + 1) / thrd_lim); }, thrd_lim);
+		parallel_radix_string_sort_impl(ref, ref + length, length, 0, pool, thrd_lim, ctx.counter<array<size_t, 257>>(thrd_lim));
+	}
+	else
+	{
+		fill(0, length);
+		radix_string_descend(ref, ref + length, length, 0);
+	}
+	radix_permute_by_index(first, ref, length);
+}
+
+//built-in traits of scalars: all digits packed are the key bits xor the digits of a zero key, and for floats the magnitude mask
+template <typename Trait, typename T>
+concept radix_scalar_trait = std::endian::native == std::endian::little && (std::is_arithmetic_v<T> || std::is_pointer_v<T>) && sizeof(T) <= sizeof(std::uint64_t)
+	&& (std::is_same_v<radix_base_trait_t<Trait>, radix_trait<T, radix_digit_bits_v<Trait>>> || std::is_same_v<radix_base_trait_t<Trait>, radix_trait_greater<T, radix_digit_bits_v<Trait>>>);
+
+//digits 0..i of an element packed into one integer, digit i most significant
+template <typename Trait, typename T, size_t... i>
+std::uint64_t radix_pack(const T& obj, std::index_sequence<i...>) noexcept
+{
+	if constexpr (radix_scalar_trait<Trait, T> && sizeof...(i) == Trait::radix_size)
+		return radix_key_bits(obj) ^ radix_magnitude_mask<T>(radix_key_bits(obj)) ^ ((std::uint64_t(Trait::template get<i>(T{})) << (i * radix_digit_bits_v<Trait>)) | ...);
+	else
+		return ((std::uint64_t(Trait::template get<i>(obj)) << (i * radix_digit_bits_v<Trait>)) | ...);
+}
+
+//compare digit i, i-1, ..., 0 of two elements, the order every radix sort in this file produces.
+//once the remaining digits fit 64 bits they are compared as one packed integer
+template <typename Trait, size_t i = Trait::radix_size - 1>
+struct radix_less
+{
+	template <typename T>
+	bool operator()(const T& a, const T& b) const noexcept
+	{
+		if constexpr ((i + 1) * radix_digit_bits_v<Trait> <= 64)
+			return radix_pack<Trait>(a, std::make_index_sequence<i + 1>{}) < radix_pack<Trait>(b, std::make_index_sequence<i + 1>{});
+		else
+		{
+			auto x = Trait::template get<i>(a), y = Trait::template get<i>(b);
+			return x != y ? x < y : radix_less<Trait, i - 1>{}(a, b);
+		}
+	}
+};
+
+//stable insertion sort for inputs too short to amortize the counters of a radix pass
+template <typename Trait, typename Iter>
+void radix_insertion_sort(Iter first, Iter second)
+{
+	using namespace std;
+	radix_less<Trait> less;
+	if (first == second)
+		return;
+	for (auto it = next(first); it != second; ++it)
+	{
+		if (!less(*it, *prev(it)))
+			continue;
+		auto tmp = std::move(*it);
+		auto hole = it;
+		do
+		{
+			*hole = std::move(*prev(hole));
+			--hole;
+		} while (hole != first && less(tmp, *prev(hole)));
+		*hole = std::move(tmp);
+	}
+}
+
+//length of the sorted prefix of [first,first+length), 0 when it is shorter than min_prefix.
+//a strictly descending prefix is reversed first, so reverse-sorted input comes back sorted and still stable
+template <typename Trait, typename Iter>
+size_t radix_sorted_prefix(Iter first, size_t length, size_t min_prefix)
+{
+	using namespace std;
+	radix_less<Trait> less;
+	size_t run = 1;
+	while (run < length && !less(first[run], first[run - 1]))
+		++run;
+	if (run == 1 && length > 1)
+	{
+		while (run < length && less(first[run], first[run - 1]))
+			++run;
+		if (run < min_prefix)
+			return 0;
+		reverse(first, first + run);
+		while (run < length && !less(first[run], first[run - 1]))
+			++run;
+	}
+	return run >= min_prefix ? run : 0;
+}
+
+//merge the sorted tail [mid,second) into the sorted [first,mid) from the back through buffer,
+//equal elements keep the prefix one first. only the prefix elements greater than the tail's smallest move
+template <typename Trait, typename Iter>
+void radix_merge_tail(Iter first, Iter mid, Iter second, typename std::iterator_traits<Iter>::value_type* buffer)
+{
+	using namespace std;
+	radix_less<Trait> less;
+	if (first == mid || mid == second || !less(*mid, *prev(mid)))
+		return;
+	auto tail = uninitialized_move(mid, second, buffer);
+	auto b = tail;
+	auto out = second;
+	while (b != buffer)
+	{
+		if (mid != first && less(*prev(b), *prev(mid)))
+			*--out = std::move(*--mid);
+		else
+			*--out = std::move(*--b);
+	}
+	destroy(buffer, tail);
+}
+
+//adaptive front end of radix_sort and parallel_radix_sort: returns true when [first,first+length) needed no radix pass.
+//otherwise sorted is the length of an ordered prefix, and only the rest has to be radix sorted and merged in
+template <typename Trait, typename Iter>
+bool radix_sort_presorted(Iter first, size_t length, const radix_sort_context& ctx, size_t& sorted)
+{
+	sorted = 0;
+	if (length <= ctx.small_sort_length_limit)
+	{
+		radix_insertion_sort<Trait>(first, first + length);
+		return true;
+	}
+	if (ctx.presorted_tail_divisor == 0)
+		return false;
+	//the prefix is at least half of the input, so sorting the tail recurses at most log(length) times
+	sorted = radix_sorted_prefix<Trait>(first, length, length - length / std::max<size_t>(ctx.presorted_tail_divisor, 2));
+	return sorted == length;
+}
+
+//elements that are nothing but their key: equal keys are equal elements, so a sort only has to count every key
+//and write it back as a run. 1 and 2 byte keys are counted directly, wider ones when the input has few distinct keys
+template <typename Trait, typename T>
+concept radix_key_only = radix_scalar_trait<Trait, T>;
+
+//all digits of an element packed, in sort order
+template <typename Trait, typename T>
+std::uint64_t radix_key(const T& obj) noexcept
+{
+	return radix_pack<Trait>(obj, std::make_index_sequence<Trait::radix_size>{});
+}
+
+//the key-only element whose packed key has the low 8 * sizeof(T) bits of key
+template <typename Trait, typename T>
+	requires radix_key_only<Trait, T>
+T radix_key_value(std::uint64_t key) noexcept
+{
+	constexpr auto key_mask = ~std::uint64_t(0) >> (64 - sizeof(T) * CHAR_BIT);
+	auto bits = (key ^ radix_key<Trait>(T{})) & key_mask;
+	bits ^= radix_magnitude_mask<T>(bits); //the magnitude mask leaves the sign bit alone
+	if constexpr (std::is_pointer_v<T>)
+		return reinterpret_cast<T>(static_cast<std::uintptr_t>(bits));
+	else if constexpr (std::is_integral_v<T>)
+		return static_cast<T>(bits);
+	else if constexpr (sizeof(T) == sizeof(std::uint32_t))
+		return std::bit_cast<T>(static_cast<std::uint32_t>(bits));
+	else
+		return std::bit_cast<T>(bits);
+}
+
+//counting sort of 1 and 2 byte key-only elements: chunk j of the input is counted into counter[j * 2^(8 * sizeof)],
+//then every chunk writes its share of the output from the summed histogram. no buffer and no scatter
+template <typename Trait, typename Iter>
+void radix_counting_sort(Iter first, Iter second, radix_thread_pool& pool, unsigned int thrd_lim, unsigned int chunk_num, size_t* counter)
+{
+	using namespace std;
+	using value_type = typename iterator_traits<Iter>::value_type;
+	constexpr size_t key_num = size_t(1) << (sizeof(value_type) * CHAR_BIT);
+	size_t length = distance(first, second);
+	auto beg = radix_instrument_now<Trait>();
+	radix_parallel_for<Trait>(pool, chunk_num, [&](size_t j) {
+		auto hist = counter + j * key_num;
+		fill_n(hist, key_num, 0);
+		for (auto it = first + length * j / chunk_num, end = first + length * (j + 1) / chunk_num; it != end; ++it)
+			++hist[radix_key<Trait>(*it) & (key_num - 1)];
+	}, thrd_lim, radix_phase::count);
+	radix_report_count<Trait>(length, beg);
+	//counter[k] becomes the end of key k's run
+	radix_parallel_for<Trait>(pool, chunk_num, [&](size_t j) {
+		for (auto k = key_num * j / chunk_num; k < key_num * (j + 1) / chunk_num; ++k)
+			for (size_t c = 1; c < chunk_num; ++c)
+				counter[k] += counter[c * key_num + k];
+	}, thrd_lim, radix_phase::prefix);
+	partial_sum(counter, counter + key_num, counter);
+	radix_parallel_for<Trait>(pool, chunk_num, [&](size_t j) {
+		size_t pos = length * j / chunk_num, end = length * (j + 1) / chunk_num;
+		for (auto k = upper_bound(counter, counter + key_num, pos) - counter; pos < end; ++k)
+		{
+			auto run_end = min<size_t>(counter[k], end);
+			auto value = radix_key_value<Trait, value_type>(k);
+			//most runs of 2 byte keys are short: store 4 copies without branching on the run length, the next runs overwrite the rest
+			if (run_end - pos <= 4 && end - pos >= 4)
+				for (size_t c = 0; c < 4; ++c)
+					first[pos + c] = value;
+			else
+				fill(first + pos, first + run_end, value);
+			pos = run_end;
+		}
+	}, thrd_lim, radix_phase::scatter);
+}
+
+//the keys of a sample of the input with their ranks among each other, in an open addressing table
+struct radix_key_table
+{
+	static constexpr size_t key_limit = 32;
+	static constexpr size_t slot_bits = 7;
+	static constexpr unsigned char empty = 0xff;
+
+	std::uint64_t key[size_t(1) << slot_bits];
+	unsigned char rank[size_t(1) << slot_bits];
+	std::uint64_t sorted[key_limit];
+	size_t key_num = 0;
+
+	radix_key_table() noexcept
+	{
+		std::fill(std::begin(rank), std::end(rank), empty);
+	}
+
+	static size_t slot(std::uint64_t k) noexcept
+	{
+		return static_cast<size_t>((k * 0x9e3779b97f4a7c15ull) >> (64 - slot_bits));
+	}
+
+	//false once more than key_limit keys were inserted
+	bool insert(std::uint64_t k) noexcept
+	{
+		for (auto s = slot(k);; s = (s + 1) % std::size(rank))
+		{
+			if (rank[s] == empty)
+			{
+				if (key_num == key_limit)
+					return false;
+				key[s] = k;
+				rank[s] = 0;
+				sorted[key_num++] = k;
+				return true;
+			}
+			if (key[s] == k)
+				return true;
+		}
+	}
+
+	void rank_keys() noexcept
+	{
+		std::sort(sorted, sorted + key_num);
+		for (size_t s = 0; s < std::size(rank); ++s)
+			if (rank[s] != empty)
+				rank[s] = static_cast<unsigned char>(std::lower_bound(sorted, sorted + key_num, key[s]) - sorted);
+	}
+
+	//rank of k, key_limit when k is not in the table
+	size_t find(std::uint64_t k) const noexcept
+	{
+		for (auto s = slot(k);; s = (s + 1) % std::size(rank))
+		{
+			if (rank[s] == empty)
+				return key_limit;
+			if (key[s] == k)
+				return rank[s];
+		}
+	}
+};
+
+//low-cardinality mode: when a sample of the input holds at most radix_key_table::key_limit distinct keys, the key space
+//is compacted to their ranks. one pass ranks every element per chunk, then key-only elements are written back as runs
+//and others take a single stable scatter through buffer, instead of a pass per digit.
+//returns false, with nothing moved, when the sample has more keys or an element's key is not among them
+template <typename Trait, typename Iter>
+bool radix_low_cardinality_sort(Iter first, Iter second, typename std::iterator_traits<Iter>::value_type* buffer, radix_sort_context& ctx, unsigned int thrd_lim)
+{
+	using namespace std;
+	using value_type = typename iterator_traits<Iter>::value_type;
+	constexpr size_t sample_num = 512;
+	constexpr auto key_limit = radix_key_table::key_limit;
+	size_t length = distance(first, second);
+	radix_key_table table;
+	for (size_t k = 0; k < sample_num; ++k)
+		if (!table.insert(radix_key<Trait>(first[length / sample_num * k])))
+			return false;
+	table.rank_keys();
+
+	auto& pool = ctx.thread_pool();
+	auto chunk_num = thrd_lim > 1 ? thrd_lim * 4 : 1;
+	auto counter = radix_context_counter<Trait, array<size_t, key_limit>>(ctx, chunk_num);
+	auto chunk = [&](size_t j) { return first + length * j / chunk_num; };
+	atomic<bool> miss = false;
+	auto beg = radix_instrument_now<Trait>();
+	radix_parallel_for<Trait>(pool, chunk_num, [&](size_t j) {
+		auto& cnt = counter[j];
+		cnt.fill(0);
+		for (auto it = chunk(j), end = chunk(j + 1); it != end && !miss.load(memory_order_relaxed); ++it)
+		{
+			auto r = table.find(radix_key<Trait>(*it));
+			if (r == key_limit)
+				miss.store(true, memory_order_relaxed);
+			else
+				++cnt[r];
+		}
+	}, thrd_lim, radix_phase::count);
+	if (miss)
+		return false;
+	radix_report_count<Trait>(length, beg);
+
+	//counter[j][r] becomes where the elements of rank r from chunk j start
+	size_t start = 0;
+	for (size_t r = 0; r < table.key_num; ++r)
+		for (size_t j = 0; j < chunk_num; ++j)
+			start += exchange(counter[j][r], start);
+	if constexpr (radix_key_only<Trait, value_type>)
+		radix_parallel_for<Trait>(pool, chunk_num, [&](size_t j) {
+			size_t pos = length * j / chunk_num, end = length * (j + 1) / chunk_num;
+			for (size_t r = upper_bound(counter[0].begin() + 1, counter[0].begin() + table.key_num, pos) - counter[0].begin() - 1; pos < end; ++r)
+			{
+				auto run_end = min(r + 1 < table.key_num ? counter[0][r + 1] : length, end);
+				fill(first + pos, first + run_end, radix_key_value<Trait, value_type>(table.sorted[r]));
+				pos = run_end;
+			}
+		}, thrd_lim, radix_phase::scatter);
+	else
+	{
+		if (buffer == nullptr)
+			buffer = radix_context_buffer<Trait, value_type>(ctx, length);
+		radix_parallel_for<Trait>(pool, chunk_num, [&](size_t j) {
+			auto& dst = counter[j];
+			for (auto it = chunk(j), end = chunk(j + 1); it != end; ++it)
+				buffer[dst[table.find(radix_key<Trait>(*it))]++] = std::move(*it);
+		}, thrd_lim, radix_phase::scatter);
+		radix_parallel_for<Trait>(pool, chunk_num, [&](size_t j) {
+			std::move(buffer + length * j / chunk_num, buffer + length * (j + 1) / chunk_num, chunk(j));
+		}, thrd_lim, radix_phase::copy);
+	}
+	return true;
+}
+
+//the direct modes that sort [first,second) without a pass per digit, false when neither applies
+template <typename Trait, typename Iter>
+bool radix_direct_sort(Iter first, Iter second, typename std::iterator_traits<Iter>::value_type* buffer, radix_sort_context& ctx, unsigned int thrd_lim)
+{
+	using namespace std;
+	using value_type = typename iterator_traits<Iter>::value_type;
+	size_t length = distance(first, second);
+	if constexpr (radix_key_only<Trait, value_type> && sizeof(value_type) <= 2)
+	{
+		//every chunk zeroes, sums and walks a 2^16 entry histogram for 2 byte keys, the LSD passes win below 4 elements per entry
+		constexpr size_t key_num = size_t(1) << (sizeof(value_type) * CHAR_BIT);
+		constexpr size_t chunk_length_limit = key_num * 4;
+		if (length < chunk_length_limit)
+			return false;
+		auto chunk_num = static_cast<unsigned int>(min<size_t>(thrd_lim, length / chunk_length_limit));
+		radix_counting_sort<Trait>(first, second, ctx.thread_pool(), chunk_num, chunk_num, radix_context_counter<Trait, size_t>(ctx, chunk_num * key_num));
+		return true;
+	}
+	else if constexpr (Trait::radix_size > 2 && Trait::radix_size * radix_digit_bits_v<Trait> <= 64)
+		return length >= ctx.low_cardinality_length_limit && radix_low_cardinality_sort<Trait>(first, second, buffer, ctx, thrd_lim);
+	else
+		return false;
+}
+
+//digit width used for radix_trait<T> when the caller does not pick a trait: 11-bit digits save passes
+//for 4 and 8 byte keys once the input is large, below that the 256 entry counters stay in L1 and win
+template <typename T>
+size_t radix_default_digit_bits(size_t length, unsigned int thrd_num) noexcept
+{
+	constexpr size_t wide_digit_length_limit = 1 << 22; //per thread
+	if constexpr ((std::is_arithmetic_v<T> || std::is_pointer_v<T>) && sizeof(T) >= 4 && sizeof(T) <= 8)
+		return length >= wide_digit_length_limit * thrd_num ? 11 : CHAR_BIT;
+	else
+		return CHAR_BIT;
+}
+
+//call func(std::type_identity<radix_trait<T, bits>>) with the width picked by radix_default_digit_bits
+template <typename T, typename Func>
+void with_default_radix_trait(size_t length, unsigned int thrd_num, Func&& func)
+{
+	if constexpr ((std::is_arithmetic_v<T> || std::is_pointer_v<T>) && sizeof(T) >= 4 && sizeof(T) <= 8)
+		if (radix_default_digit_bits<T>(length, thrd_num) == 11)
+			return func(std::type_identity<radix_trait<T, 11>>{});
+	func(std::type_identity<radix_trait<T>>{});
+}
+
+template <typename Trait, typename Iter>
+void radix_sort(Iter first, Iter second, typename std::iterator_traits<Iter>::value_type* buffer, radix_sort_context& ctx)
+{
+	using namespace std;
+	using value_type = typename iterator_traits<Iter>::value_type;
+	auto length = distance(first, second);
+	size_t sorted;
+	if (radix_sort_presorted<Trait>(first, length, ctx, sorted))
+		return;
+	if (sorted == 0 && radix_direct_sort<Trait>(first, second, buffer, ctx, 1))
+		return;
+	if (buffer == nullptr)
+		buffer = radix_context_buffer<Trait, value_type>(ctx, length);
+	if (sorted > 0)
+	{
+		radix_sort<Trait>(first + sorted, second, buffer, ctx);
+		radix_merge_tail<Trait>(first, first + sorted, second, buffer);
+		return;
+	}
+	radix_stop stop{ ctx.stop_token };
+	if (length <= INT_MAX) //int is enough for counter
+	{
+		auto counter = radix_context_counter<Trait, radix_histograms<Trait, int>>(ctx, 1);
+		radix_sort_impl<0, Trait, Iter>(first, second, buffer, *counter, false, stop);
+	}
+	else
+	{
+		auto counter = radix_context_counter<Trait, radix_histograms<Trait, decltype(length)>>(ctx, 1);
+		radix_sort_impl<0, Trait, Iter>(first, second, buffer, *counter, false, stop);
+	}
+	if (stop.stopped)
+		ctx.stopped_early = true;
+}
+
+//variable-length keys need no element buffer
+template <typename Trait, typename Iter>
+	requires radix_string_trait<Trait, typename std::iterator_traits<Iter>::value_type>
+void radix_sort(Iter first, Iter second, typename std::iterator_traits<Iter>::value_type*, radix_sort_context& ctx)
+{
+	string_radix_sort_impl<Trait, false>(first, second, ctx);
+}
+
+template <typename Trait, typename Iter>
+void radix_sort(Iter first, Iter second, radix_sort_context& ctx)
+{
+	radix_sort<Trait>(first, second, nullptr, ctx);
+}
+
+template <typename Trait, typename Iter>
+void radix_sort(Iter first, Iter second, typename std::iterator_traits<Iter>::value_type* buffer = nullptr)
+{
+	radix_sort_context ctx;
+	radix_sort<Trait>(first, second, buffer, ctx);
+}
+
+template <typename Iter>
+void radix_sort(Iter first, Iter second, radix_sort_context& ctx)
+{
+	with_default_radix_trait<typename std::iterator_traits<Iter>::value_type>(std::distance(first, second), 1, [&](auto trait) {
+		radix_sort<typename decltype(trait)::type>(first, second, nullptr, ctx);
+	});
+}
+
+template <typename Iter>
+void radix_sort(Iter first, Iter second, typename std::iterator_traits<Iter>::value_type* buffer = nullptr)
+{
+	with_default_radix_trait<typename std::iterator_traits<Iter>::value_type>(std::distance(first, second), 1, [&](auto trait) {
+		radix_sort<typename decltype(trait)::type>(first, second, buffer);
+	});
+}
+
+template <typename Trait, typename Iter>
+void parallel_radix_sort(Iter first, Iter second, typename std::iterator_traits<Iter>::value_type* buffer, radix_sort_context& ctx)
+{
+	using namespace std;
+	using value_type = typename iterator_traits<Iter>::value_type;
+	constexpr auto thrd_chunk_num = 4; //chunks per thread, so idle threads have something to steal
+	auto length = distance(first, second);
+	auto thrd_lim = ctx.thread_num(length);
+	if (thrd_lim > 1)
+	{
+		size_t sorted;
+		if (radix_sort_presorted<Trait>(first, length, ctx, sorted))
+			return;
+		if (sorted == 0 && radix_direct_sort<Trait>(first, second, buffer, ctx, thrd_lim))
+			return;
+		if (buffer == nullptr)
+			buffer = radix_context_buffer<Trait, value_type>(ctx, length);
+		if (sorted > 0)
+		{
+			parallel_radix_sort<Trait>(first + sorted, second, buffer, ctx);
+			radix_merge_tail<Trait>(first, first + sorted, second, buffer);
+			return;
+		}
+		//cnt type optimize seems negative in multi-thread?
+		auto chunk_num = thrd_lim * thrd_chunk_num;
+		bool hybrid = Trait::radix_size > 1 && static_cast<size_t>(length) >= ctx.hybrid_sort_length_limit;
+		auto counter = radix_context_counter<Trait, radix_chunk_counter<Trait, decltype(length)>>(ctx, chunk_num + (hybrid ? thrd_lim : 0));
+		radix_stop stop{ ctx.stop_token };
+		if constexpr (Trait::radix_size > 1)
+			hybrid = hybrid && parallel_hybrid_radix_sort_impl<Trait>(first, second, ctx.thread_pool(), thrd_lim, chunk_num, buffer, counter, stop);
+		if (!hybrid)
+			parallel_radix_sort_impl<0, Iter, Trait>(first, second, ctx.thread_pool(), thrd_lim, chunk_num, buffer, counter, false, false, stop);
+		if (stop.stopped)
+			ctx.stopped_early = true;
+	}
+	else
+		radix_sort<Trait>(first, second, buffer, ctx);
+}
+
+template <typename Trait, typename Iter>
+	requires radix_string_trait<Trait, typename std::iterator_traits<Iter>::value_type>
+void parallel_radix_sort(Iter first, Iter second, typename std::iterator_traits<Iter>::value_type*, radix_sort_context& ctx)
+{
+	string_radix_sort_impl<Trait, true>(first, second, ctx);
+}
+
+template <typename Trait, typename Iter>
+void parallel_radix_sort(Iter first, Iter second, radix_sort_context& ctx)
+{
+	parallel_radix_sort<Trait>(first, second, nullptr, ctx);
+}
+
+template <typename Trait, typename Iter>
+void parallel_radix_sort(Iter first, Iter second, typename std::iterator_traits<Iter>::value_type* buffer = nullptr, unsigned int thrd_lim = radix_hardware_concurrency(), radix_thread_pool& pool = radix_thread_pool::global())
+{
+	radix_sort_context ctx(thrd_lim, radix_sort_context::default_thrd_sort_length_limit, &pool);
+	parallel_radix_sort<Trait>(first, second, buffer, ctx);
+}
+
+template <typename Iter>
+void parallel_radix_sort(Iter first, Iter second, radix_sort_context& ctx)
+{
+	auto length = std::distance(first, second);
+	with_default_radix_trait<typename std::iterator_traits<Iter>::value_type>(length, ctx.thread_num(length), [&](auto trait) {
+		parallel_radix_sort<typename decltype(trait)::type>(first, second, nullptr, ctx);
+	});
+}
+
+template <typename Iter>
+void parallel_radix_sort(Iter first, Iter second, typename std::iterator_traits<Iter>::value_type* buffer = nullptr, unsigned int thrd_lim = radix_hardware_concurrency(), radix_thread_pool& pool = radix_thread_pool::global())
+{
+	radix_sort_context ctx(thrd_lim, radix_sort_context::default_thrd_sort_length_limit, &pool);
+	auto length = std::distance(first, second);
+	with_default_radix_trait<typename std::iterator_traits<Iter>::value_type>(length, ctx.thread_num(length), [&](auto trait) {
+		parallel_radix_sort<typename decltype(trait)::type>(first, second, buffer, ctx);
+	});
+}
+
+template <typename ExecutionPolicy>
+constexpr bool is_parallel_policy_v = std::is_same_v<std::remove_cvref_t<ExecutionPolicy>, std::execution::parallel_policy> || std::is_same_v<std::remove_cvref_t<ExecutionPolicy>, std::execution::parallel_unsequenced_policy>;
+
+template <typename Trait, typename Iter, typename ExecutionPolicy>
+	requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+void radix_sort(Iter first, Iter second, ExecutionPolicy&& policy, radix_sort_context& ctx)
+{
+	if constexpr (is_parallel_policy_v<ExecutionPolicy>)
+		parallel_radix_sort<Trait>(first, second, nullptr, ctx);
+	else
+		radix_sort<Trait>(first, second, nullptr, ctx);
+}
+
+template <typename Iter, typename ExecutionPolicy>
+	requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+void radix_sort(Iter first, Iter second, ExecutionPolicy&& policy, radix_sort_context& ctx)
+{
+	if constexpr (is_parallel_policy_v<ExecutionPolicy>)
+		parallel_radix_sort(first, second, ctx);
+	else
+		radix_sort(first, second, ctx);
+}
+
+template <typename Iter, typename ExecutionPolicy>
+	requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+void radix_sort(Iter first, Iter second, ExecutionPolicy&& policy, typename std::iterator_traits<Iter>::value_type* buffer = nullptr)
+{
+	if constexpr (is_parallel_policy_v<ExecutionPolicy>)
+		parallel_radix_sort(first, second, buffer);
+	else
+		radix_sort(first, second, buffer);
+}
+
+template <typename Trait, typename Iter, typename ExecutionPolicy>
+	requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+void radix_sort(Iter first, Iter second, ExecutionPolicy&& policy, typename std::iterator_traits<Iter>::value_type* buffer = nullptr)
+{
+	if constexpr (is_parallel_policy_v<ExecutionPolicy>)
+		parallel_radix_sort<Trait>(first, second, buffer);
+	else
+		radix_sort<Trait>(first, second, buffer);
+}
+
+//thrown by radix_sort_task::get() when cancel() stopped the sort before its last pass, or before it started
+class radix_sort_cancelled : public std::runtime_error
+{
+public:
+	radix_sort_cancelled() : std::runtime_error("radix_sort: cancelled")
+	{
+	}
+};
+
+//shared by a radix_sort_task and the pool task running its sort
+struct radix_async_state
+{
+	std::mutex mtx;
+	std::condition_variable done_cv;
+	bool started = false, done = false, cancelled = false;
+	std::exception_ptr error;
+	std::stop_source stop;
+	std::coroutine_handle<> continuation;
+	radix_sort_context own_ctx;
+	radix_sort_context* ctx = &own_ctx;
+	std::function<void(radix_sort_context&)> sort;
+
+	//sort once, on a worker or on the first thread that waits for a task no worker has started yet
+	void run()
+	{
+		{
+			std::lock_guard lock(mtx);
+			if (std::exchange(started, true))
+				return;
+		}
+		//cancelled only when the range was left unsorted: a sort never started, or one that skipped passes
+		bool skipped = true;
+		if (!stop.stop_requested())
+		{
+			auto outer = std::exchange(ctx->stop_token, stop.get_token());
+			auto outer_stopped = std::exchange(ctx->stopped_early, false);
+			try
+			{
+				sort(*ctx);
+			}
+			catch (...)
+			{
+				error = std::current_exception();
+			}
+			skipped = std::exchange(ctx->stopped_early, outer_stopped);
+			ctx->stop_token = std::move(outer);
+		}
+		std::unique_lock lock(mtx);
+		cancelled = skipped;
+		done = true;
+		auto awaiting = std::exchange(continuation, {});
+		lock.unlock();
+		done_cv.notify_all();
+		if (awaiting)
+			awaiting.resume();
+	}
+};
+
+//handle of a sort started by radix_sort_async. the range, and a context passed in, must stay alive until the sort is done;
+//destroying a handle waits for its sort. co_await resumes the awaiting coroutine on the thread that finished the sort
+class radix_sort_task
+{
+public:
+	explicit radix_sort_task(std::shared_ptr<radix_async_state> state) noexcept : state(std::move(state))
+	{
+	}
+	radix_sort_task(radix_sort_task&&) noexcept = default;
+	radix_sort_task& operator=(radix_sort_task&& other) noexcept
+	{
+		if (this != &other)
+		{
+			wait();
+			state = std::move(other.state);
+		}
+		return *this;
+	}
+	~radix_sort_task()
+	{
+		wait();
+	}
+
+	//false for a moved-from handle, which has no sort: ready() and wait() return at once, get() throws std::future_error
+	bool valid() const noexcept
+	{
+		return state != nullptr;
+	}
+
+	bool ready() const
+	{
+		if (!state)
+			return true;
+		std::lock_guard lock(state->mtx);
+		return state->done;
+	}
+
+	void wait() const
+	{
+		if (!state)
+			return;
+		state->run();
+		std::unique_lock lock(state->mtx);
+		state->done_cv.wait(lock, [&] { return state->done; });
+	}
+
+	//wait, then rethrow what the sort threw, or radix_sort_cancelled
+	void get() const
+	{
+		if (!state)
+			throw std::future_error(std::future_errc::no_state);
+		wait();
+		if (state->error)
+			std::rethrow_exception(state->error);
+		if (state->cancelled)
+			throw radix_sort_cancelled();
+	}
+
+	//stop the sort before its next digit pass, a sort not started yet does not touch the range
+	void cancel() noexcept
+	{
+		if (state)
+			state->stop.request_stop();
+	}
+
+	//true once a finished sort has left its range unsorted because of cancel()
+	bool cancelled() const
+	{
+		if (!state)
+			return false;
+		std::lock_guard lock(state->mtx);
+		return state->cancelled;
+	}
+
+	bool await_ready() const
+	{
+		return ready();
+	}
+
+	//like wait(), a sort no worker has started yet runs right here
+	bool await_suspend(std::coroutine_handle<> awaiting)
+	{
+		if (!state)
+			return false;
+		state->run();
+		std::lock_guard lock(state->mtx);
+		if (state->done)
+			return false;
+		state->continuation = awaiting;
+		return true;
+	}
+
+	void await_resume() const
+	{
+		get();
+	}
+
+private:
+	std::shared_ptr<radix_async_state> state;
+};
+
+//start sort(ctx) on a worker of ctx's pool, or of radix_thread_pool::global() with a context of the task's own
+template <typename Func>
+radix_sort_task radix_sort_async_impl(radix_sort_context* ctx, Func&& sort)
+{
+	auto state = std::make_shared<radix_async_state>();
+	if (ctx)
+		state->ctx = ctx;
+	state->sort = std::forward<Func>(sort);
+	radix_sort_task task(state);
+	state->ctx->thread_pool().submit([state] { state->run(); });
+	return task;
+}
+
+template <typename Trait, typename Iter, typename ExecutionPolicy>
+	requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+radix_sort_task radix_sort_async(Iter first, Iter second, ExecutionPolicy&& policy, radix_sort_context& ctx)
+{
+	return radix_sort_async_impl(&ctx, [=](radix_sort_context& c) { radix_sort<Trait>(first, second, policy, c); });
+}
+
+template <typename Trait, typename Iter, typename ExecutionPolicy>
+	requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+radix_sort_task radix_sort_async(Iter first, Iter second, ExecutionPolicy&& policy)
+{
+	return radix_sort_async_impl(nullptr, [=](radix_sort_context& c) { radix_sort<Trait>(first, second, policy, c); });
+}
+
+template <typename Trait, typename Iter>
+radix_sort_task radix_sort_async(Iter first, Iter second, radix_sort_context& ctx)
+{
+	return radix_sort_async_impl(&ctx, [=](radix_sort_context& c) { radix_sort<Trait>(first, second, c); });
+}
+
+template <typename Trait, typename Iter>
+radix_sort_task radix_sort_async(Iter first, Iter second)
+{
+	return radix_sort_async_impl(nullptr, [=](radix_sort_context& c) { radix_sort<Trait>(first, second, c); });
+}
+
+template <typename Iter, typename ExecutionPolicy>
+	requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+radix_sort_task radix_sort_async(Iter first, Iter second, ExecutionPolicy&& policy, radix_sort_context& ctx)
+{
+	return radix_sort_async_impl(&ctx, [=](radix_sort_context& c) { radix_sort(first, second, policy, c); });
+}
+
+template <typename Iter, typename ExecutionPolicy>
+	requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+radix_sort_task radix_sort_async(Iter first, Iter second, ExecutionPolicy&& policy)
+{
+	return radix_sort_async_impl(nullptr, [=](radix_sort_context& c) { radix_sort(first, second, policy, c); });
+}
+
+template <typename Iter>
+radix_sort_task radix_sort_async(Iter first, Iter second, radix_sort_context& ctx)
+{
+	return radix_sort_async_impl(&ctx, [=](radix_sort_context& c) { radix_sort(first, second, c); });
+}
+
+template <typename Iter>
+radix_sort_task radix_sort_async(Iter first, Iter second)
+{
+	return radix_sort_async_impl(nullptr, [=](radix_sort_context& c) { radix_sort(first, second, c); });
+}
+
+template <typename T>
+struct radix_is_tuple : std::false_type
+{
+};
+
+template <typename... T>
+struct radix_is_tuple<std::tuple<T...>> : std::true_type
+{
+};
+
+//values_first of radix_sort_by_key is one iterator or a std::tuple of iterators, one per value column
+template <typename ValIter>
+auto radix_value_columns(ValIter values_first)
+{
+	if constexpr (radix_is_tuple<ValIter>::value)
+		return values_first;
+	else
+		return std::make_tuple(values_first);
+}
+
+template <typename Src, typename Dst, size_t... v>
+void move_value_columns(const Src& src, const Dst& dst, size_t pos_beg, size_t pos_end, std::index_sequence<v...>)
+{
+	(std::move(std::get<v>(src) + pos_beg, std::get<v>(src) + pos_end, std::get<v>(dst) + pos_beg), ...);
+}
+
+//scatter every value column after the digits of key_src, then the key column itself.
+//one column at a time keeps 256 open destinations instead of 256 per column, and lets each use radix_place's staging
+template<size_t i, typename Trait, typename KeySrc, typename KeyDst, typename ValSrc, typename ValDst, typename cnt_type, size_t... v>
+void place_by_key(KeySrc key_src, KeyDst key_dst, const ValSrc& val_src, const ValDst& val_dst, radix_counter<Trait, cnt_type>& counter, size_t pos_beg, size_t pos_end, size_t length, std::index_sequence<v...>)
+{
+	auto place_values = [&](auto& src, auto& dst) {
+		auto cnt = counter;
+		radix_place_column<i, Trait>(key_src, src, dst, cnt, pos_beg, pos_end, length);
+	};
+	(place_values(std::get<v>(val_src), std::get<v>(val_dst)), ...);
+	radix_place<i, Trait>(key_src, key_dst, counter, pos_beg, pos_end, length);
+}
+
+template <size_t i, typename Trait, typename KeyIter, typename ValIters, typename ValBuffers, typename cnt_type>
+void radix_sort_by_key_impl(KeyIter first, KeyIter second, const ValIters& values, typename std::iterator_traits<KeyIter>::value_type* buffer, const ValBuffers& value_buffer, radix_histograms<Trait, cnt_type>& counter, bool in_buffer = false)
+{
+	using namespace std;
+	constexpr auto radix_size = Trait::radix_size;
+	constexpr auto columns = make_index_sequence<tuple_size_v<ValIters>>{};
+	auto length = distance(first, second);
+
+	if constexpr (i == 0)
+		count_all_duff_device<Trait>(first, second, counter);
+	if constexpr (i < radix_size)
+	{
+		if (!is_trivial_pass<i, Trait>(first, length, counter[i]))
+		{
+			for (size_t j = 1; j < radix_bucket_num_v<Trait>; ++j)
+				counter[i][j] += counter[i][j - 1];
+			if (in_buffer)
+				place_by_key<i, Trait>(buffer, first, value_buffer, values, counter[i], 0, length, length, columns);
+			else
+				place_by_key<i, Trait>(first, buffer, values, value_buffer, counter[i], 0, length, length, columns);
+			in_buffer = !in_buffer;
+		}
+	}
+	if constexpr (i + 1 < radix_size)
+	{
+		radix_sort_by_key_impl<i + 1, Trait>(first, second, values, buffer, value_buffer, counter, in_buffer);
+	}
+	else if (in_buffer)
+	{
+		std::move(buffer, buffer + length, first);
+		move_value_columns(value_buffer, values, 0, length, columns);
+	}
+}
+
+template <size_t i, typename Trait, typename KeyIter, typename ValIters, typename ValBuffers, typename cnt_type>
+void parallel_radix_sort_by_key_impl(KeyIter first, KeyIter second, const ValIters& values, radix_thread_pool& pool, unsigned int thrd_lim, unsigned int chunk_num, typename std::iterator_traits<KeyIter>::value_type* buffer, const ValBuffers& value_buffer, radix_chunk_counter<Trait, cnt_type>* counter, bool in_buffer = false, bool permuted = false)
+{
+	using namespace std;
+	constexpr auto radix_size = Trait::radix_size;
+	constexpr auto columns = make_index_sequence<tuple_size_v<ValIters>>{};
+	auto length = distance(first, second), parallel_width = length / chunk_num;
+	auto chunk_end = [&](size_t j) { return j == chunk_num - 1 ? length : (j + 1) * parallel_width; };
+
+	if constexpr (i == 0)
+		pool.parallel_for(chunk_num, [&](size_t j) {
+			count_all_duff_device<Trait>(first + j * parallel_width, first + chunk_end(j), counter[j].histogram);
+		}, thrd_lim);
+	if constexpr (i < radix_size)
+	{
+		cnt_type total = 0;
+		auto digit = Trait::template get<i>(*first);
+		for (auto j = 0u; j < chunk_num; ++j)
+			total += counter[j].histogram[i][digit];
+		if (total != length)
+		{
+			if (permuted)
+				pool.parallel_for(chunk_num, [&](size_t j) {
+					if (in_buffer)
+						count_duff_device<i, Trait>(buffer + j * parallel_width, buffer + chunk_end(j), counter[j].histogram[i]);
+					else
+						count_duff_device<i, Trait>(first + j * parallel_width, first + chunk_end(j), counter[j].histogram[i]);
+				}, thrd_lim);
+			merge_chunk_histograms<i>(pool, thrd_lim, chunk_num, counter);
+			pool.parallel_for(chunk_num, [&](size_t j) {
+				auto& cnt = chunk_offset<i>(counter, chunk_num, j);
+				if (in_buffer)
+					place_by_key<i, Trait>(buffer, first, value_buffer, values, cnt, j * parallel_width, chunk_end(j), length, columns);
+				else
+					place_by_key<i, Trait>(first, buffer, values, value_buffer, cnt, j * parallel_width, chunk_end(j), length, columns);
+			}, thrd_lim);
+			in_buffer = !in_buffer;
+			permuted = true;
+		}
+	}
+	if constexpr (i + 1 < radix_size)
+	{
+		parallel_radix_sort_by_key_impl<i + 1, Trait>(first, second, values, pool, thrd_lim, chunk_num, buffer, value_buffer, counter, in_buffer, permuted);
+	}
+	else if (in_buffer)
+	{
+		pool.parallel_for(chunk_num, [&](size_t j) {
+			std::move(buffer + j * parallel_width, buffer + chunk_end(j), first + j * parallel_width);
+			move_value_columns(value_buffer, values, j * parallel_width, chunk_end(j), columns);
+		}, thrd_lim);
+	}
+}
+
+//one scratch block from ctx split into cache line aligned buffers for the key column and every value column
+template <typename KeyIter, typename ValIters, size_t... v>
+auto radix_by_key_buffers(radix_sort_context& ctx, size_t length, std::index_sequence<v...>)
+{
+	using namespace std;
+	auto column_size = [&](size_t value_size) { return (length * value_size + 63) / 64 * 64; };
+	using key_type = typename iterator_traits<KeyIter>::value_type;
+	auto scratch = ctx.buffer<unsigned char>(column_size(sizeof(key_type)) + (column_size(sizeof(typename iterator_traits<tuple_element_t<v, ValIters>>::value_type)) + ... + 0));
+	auto pos = scratch + column_size(sizeof(key_type));
+	auto take = [&](size_t value_size) { return exchange(pos, pos + column_size(value_size)); };
+	tuple<typename iterator_traits<tuple_element_t<v, ValIters>>::value_type*...> value_buffer{
+		reinterpret_cast<typename iterator_traits<tuple_element_t<v, ValIters>>::value_type*>(take(sizeof(typename iterator_traits<tuple_element_t<v, ValIters>>::value_type)))... };
+	(uninitialized_default_construct_n(get<v>(value_buffer), length), ...); //values need not be trivial, unlike radix keys
+	return make_pair(reinterpret_cast<key_type*>(scratch), value_buffer);
+}
+
+template <typename ValBuffers, size_t... v>
+void destroy_value_buffers(const ValBuffers& value_buffer, size_t length, std::index_sequence<v...>)
+{
+	(std::destroy_n(std::get<v>(value_buffer), length), ...);
+}
+
+template <typename Trait, typename KeyIter, typename ValIter>
+void radix_sort_by_key(KeyIter keys_first, KeyIter keys_last, ValIter values_first, radix_sort_context& ctx)
+{
+	using namespace std;
+	auto values = radix_value_columns(values_first);
+	auto length = distance(keys_first, keys_last);
+	constexpr auto columns = make_index_sequence<tuple_size_v<decltype(values)>>{};
+	auto [buffer, value_buffer] = radix_by_key_buffers<KeyIter, decltype(values)>(ctx, length, columns);
+	if (length <= INT_MAX) //int is enough for counter
+	{
+		auto counter = ctx.counter<radix_histograms<Trait, int>>(1);
+		radix_sort_by_key_impl<0, Trait>(keys_first, keys_last, values, buffer, value_buffer, *counter);
+	}
+	else
+	{
+		auto counter = ctx.counter<radix_histograms<Trait, decltype(length)>>(1);
+		radix_sort_by_key_impl<0, Trait>(keys_first, keys_last, values, buffer, value_buffer, *counter);
+	}
+	destroy_value_buffers(value_buffer, length, columns);
+}
+
+template <typename Trait, typename KeyIter, typename ValIter>
+void radix_sort_by_key(KeyIter keys_first, KeyIter keys_last, ValIter values_first)
+{
+	radix_sort_context ctx;
+	radix_sort_by_key<Trait>(keys_first, keys_last, values_first, ctx);
+}
+
+template <typename KeyIter, typename ValIter>
+void radix_sort_by_key(KeyIter keys_first, KeyIter keys_last, ValIter values_first, radix_sort_context& ctx)
+{
+	with_default_radix_trait<typename std::iterator_traits<KeyIter>::value_type>(std::distance(keys_first, keys_last), 1, [&](auto trait) {
+		radix_sort_by_key<typename decltype(trait)::type>(keys_first, keys_last, values_first, ctx);
+	});
+}
+
+template <typename KeyIter, typename ValIter>
+void radix_sort_by_key(KeyIter keys_first, KeyIter keys_last, ValIter values_first)
+{
+	radix_sort_context ctx;
+	radix_sort_by_key(keys_first, keys_last, values_first, ctx);
+}
+
+template <typename Trait, typename KeyIter, typename ValIter>
+void parallel_radix_sort_by_key(KeyIter keys_first, KeyIter keys_last, ValIter values_first, radix_sort_context& ctx)
+{
+	using namespace std;
+	constexpr auto thrd_chunk_num = 4; //chunks per thread, so idle threads have something to steal
+	auto length = distance(keys_first, keys_last);
+	auto thrd_lim = ctx.thread_num(length);
+	if (thrd_lim > 1)
+	{
+		auto values = radix_value_columns(values_first);
+		constexpr auto columns = make_index_sequence<tuple_size_v<decltype(values)>>{};
+		auto [buffer, value_buffer] = radix_by_key_buffers<KeyIter, decltype(values)>(ctx, length, columns);
+		auto chunk_num = thrd_lim * thrd_chunk_num;
+		auto counter = ctx.counter<radix_chunk_counter<Trait, decltype(length)>>(chunk_num);
+		parallel_radix_sort_by_key_impl<0, Trait>(keys_first, keys_last, values, ctx.thread_pool(), thrd_lim, chunk_num, buffer, value_buffer, counter);
+		destroy_value_buffers(value_buffer, length, columns);
+	}
+	else
+		radix_sort_by_key<Trait>(keys_first, keys_last, values_first, ctx);
+}
+
+template <typename Trait, typename KeyIter, typename ValIter>
+void parallel_radix_sort_by_key(KeyIter keys_first, KeyIter keys_last, ValIter values_first)
+{
+	radix_sort_context ctx;
+	parallel_radix_sort_by_key<Trait>(keys_first, keys_last, values_first, ctx);
+}
+
+template <typename KeyIter, typename ValIter>
+void parallel_radix_sort_by_key(KeyIter keys_first, KeyIter keys_last, ValIter values_first, radix_sort_context& ctx)
+{
+	auto length = std::distance(keys_first, keys_last);
+	with_default_radix_trait<typename std::iterator_traits<KeyIter>::value_type>(length, ctx.thread_num(length), [&](auto trait) {
+		parallel_radix_sort_by_key<typename decltype(trait)::type>(keys_first, keys_last, values_first, ctx);
+	});
+}
+
+template <typename KeyIter, typename ValIter>
+void parallel_radix_sort_by_key(KeyIter keys_first, KeyIter keys_last, ValIter values_first)
+{
+	radix_sort_context ctx;
+	parallel_radix_sort_by_key(keys_first, keys_last, values_first, ctx);
+}
+
+template <typename Trait, typename KeyIter, typename ValIter, typename ExecutionPolicy>
+	requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+void radix_sort_by_key(KeyIter keys_first, KeyIter keys_last, ValIter values_first, ExecutionPolicy&& policy, radix_sort_context& ctx)
+{
+	if constexpr (is_parallel_policy_v<ExecutionPolicy>)
+		parallel_radix_sort_by_key<Trait>(keys_first, keys_last, values_first, ctx);
+	else
+		radix_sort_by_key<Trait>(keys_first, keys_last, values_first, ctx);
+}
+
+template <typename Trait, typename KeyIter, typename ValIter, typename ExecutionPolicy>
+	requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+void radix_sort_by_key(KeyIter keys_first, KeyIter keys_last, ValIter values_first, ExecutionPolicy&& policy)
+{
+	radix_sort_context ctx;
+	radix_sort_by_key<Trait>(keys_first, keys_last, values_first, policy, ctx);
+}
+
+template <typename KeyIter, typename ValIter, typename ExecutionPolicy>
+	requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+void radix_sort_by_key(KeyIter keys_first, KeyIter keys_last, ValIter values_first, ExecutionPolicy&& policy, radix_sort_context& ctx)
+{
+	if constexpr (is_parallel_policy_v<ExecutionPolicy>)
+		parallel_radix_sort_by_key(keys_first, keys_last, values_first, ctx);
+	else
+		radix_sort_by_key(keys_first, keys_last, values_first, ctx);
+}
+
+template <typename KeyIter, typename ValIter, typename ExecutionPolicy>
+	requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+void radix_sort_by_key(KeyIter keys_first, KeyIter keys_last, ValIter values_first, ExecutionPolicy&& policy)
+{
+	radix_sort_context ctx;
+	radix_sort_by_key(keys_first, keys_last, values_first, policy, ctx);
+}
+
+//American flag permutation: swap every element of [first+head[b],first+tail[b]) into its bucket
+template <size_t i, typename Trait, typename Iter, typename cnt_type>
+void american_flag_permute(Iter first, radix_counter<Trait, cnt_type>& head, const radix_counter<Trait, cnt_type>& tail)
+{
+	for (size_t b = 0; b < radix_bucket_num_v<Trait>; ++b)
+	{
+		while (head[b] < tail[b])
+		{
+			auto d = Trait::template get<i>(first[head[b]]);
+			if (d == b)
+				++head[b];
+			else
+				std::iter_swap(first + head[b], first + head[d]++);
+		}
+	}
+}
+
+template <size_t i, typename Trait, typename Iter>
+void inplace_radix_sort_impl(Iter first, Iter second)
+{
+	using namespace std;
+	static_assert(radix_digit_bits_v<Trait> <= 11, "in-place sort keeps one bucket counter per level on the stack");
+	constexpr auto inplace_sort_length_limit = 128; //buckets below this are finished by comparison sort
+	auto length = distance(first, second);
+	if (length <= inplace_sort_length_limit)
+	{
+		sort(first, second, radix_less<Trait, i>{});
+		return;
+	}
+	radix_counter<Trait, ptrdiff_t> counter, head, tail;
+	count_duff_device<i, Trait>(first, second, counter);
+	ptrdiff_t pos = 0;
+	for (size_t b = 0; b < radix_bucket_num_v<Trait>; ++b)
+	{
+		head[b] = pos;
+		pos += counter[b];
+		tail[b] = pos;
+	}
+	if (!is_trivial_pass<i, Trait>(first, length, counter))
+		american_flag_permute<i, Trait>(first, head, tail);
+	if constexpr (i > 0)
+	{
+		for (size_t b = 0; b < radix_bucket_num_v<Trait>; ++b)
+			if (counter[b] > 1)
+				inplace_radix_sort_impl<i - 1, Trait>(first + (tail[b] - counter[b]), first + tail[b]);
+	}
+}
+
+//PARADIS-style parallel in-place partition on digit i, then the buckets are sorted independently
+template <size_t i, typename Trait, typename Iter>
+void parallel_inplace_radix_sort_impl(Iter first, Iter second, radix_thread_pool& pool, unsigned int thrd_lim, radix_counter<Trait, std::ptrdiff_t>* counter)
+{
+	using namespace std;
+	constexpr auto bucket_size = radix_bucket_num_v<Trait>;
+	auto length = distance(first, second), parallel_width = length / thrd_lim;
+	auto chunk_end = [&](size_t j) { return j == thrd_lim - 1 ? length : (j + 1) * parallel_width; };
+	//counter[0..thrd_lim) are histograms, then per-thread stripe heads and tails
+	auto stripe_head = counter + thrd_lim, stripe_tail = counter + 2 * thrd_lim;
+
+	pool.parallel_for(thrd_lim, [&](size_t j) {
+		count_duff_device<i, Trait>(first + j * parallel_width, first + chunk_end(j), counter[j]);
+	}, thrd_lim);
+	array<ptrdiff_t, bucket_size> bucket_beg, head, tail;
+	ptrdiff_t pos = 0;
+	for (size_t b = 0; b < bucket_size; ++b)
+	{
+		bucket_beg[b] = head[b] = pos;
+		for (auto j = 0u; j < thrd_lim; ++j)
+			pos += counter[j][b];
+		tail[b] = pos;
+	}
+	if (tail[Trait::template get<i>(*first)] - head[Trait::template get<i>(*first)] != length)
+	{
+		//each thread permutes inside its own stripe of every bucket, leftovers are pushed to the stripe tail
+		auto remaining = length;
+		while (remaining > static_cast<ptrdiff_t>(thrd_lim * bucket_size))
+		{
+			for (auto t = 0u; t < thrd_lim; ++t)
+				for (size_t b = 0; b < bucket_size; ++b)
+				{
+					auto width = tail[b] - head[b];
+					stripe_head[t][b] = head[b] + width * t / thrd_lim;
+					stripe_tail[t][b] = head[b] + width * (t + 1) / thrd_lim;
+				}
+			pool.parallel_for(thrd_lim, [&](size_t t) {
+				auto& ph = stripe_head[t];
+				auto& pt = stripe_tail[t];
+				for (size_t b = 0; b < bucket_size; ++b)
+					while (ph[b] < pt[b])
+					{
+						auto cur = first + ph[b];
+						auto d = Trait::template get<i>(*cur);
+						while (d != b && ph[d] < pt[d])
+						{
+							iter_swap(cur, first + ph[d]++);
+							d = Trait::template get<i>(*cur);
+						}
+						if (d == b)
+							++ph[b];
+						else
+							iter_swap(cur, first + --pt[b]);
+					}
+			}, thrd_lim);
+			//move the misplaced elements of each bucket behind the placed ones
+			pool.parallel_for(bucket_size, [&](size_t b) {
+				head[b] = partition(first + head[b], first + tail[b], [b](const auto& obj) { return Trait::template get<i>(obj) == b; }) - first;
+			}, thrd_lim);
+			ptrdiff_t left = 0;
+			for (size_t b = 0; b < bucket_size; ++b)
+				left += tail[b] - head[b];
+			if (left * 2 > remaining) //stripes became too unbalanced to make progress
+			{
+				remaining = left;
+				break;
+			}
+			remaining = left;
+		}
+		if (remaining)
+			american_flag_permute<i, Trait>(first, head, tail);
+	}
+	if constexpr (i > 0)
+	{
+		//large buckets keep partitioning in parallel, the rest are stolen by idle threads, biggest first
+		array<unsigned int, bucket_size> order;
+		for (size_t b = 0; b < bucket_size; ++b)
+			order[b] = b;
+		sort(order.begin(), order.end(), [&](auto x, auto y) { return tail[x] - bucket_beg[x] > tail[y] - bucket_beg[y]; });
+		size_t large_num = 0;
+		for (; large_num < bucket_size && (tail[order[large_num]] - bucket_beg[order[large_num]]) * thrd_lim > length; ++large_num)
+		{
+			auto b = order[large_num];
+			parallel_inplace_radix_sort_impl<i - 1, Trait>(first + bucket_beg[b], first + tail[b], pool, thrd_lim, counter);
+		}
+		pool.parallel_for(bucket_size - large_num, [&](size_t k) {
+			if (auto b = order[large_num + k]; tail[b] - bucket_beg[b] > 1)
+				inplace_radix_sort_impl<i - 1, Trait>(first + bucket_beg[b], first + tail[b]);
+		}, thrd_lim);
+	}
+}
+
+template <typename Trait, typename Iter>
+void inplace_radix_sort(Iter first, Iter second)
+{
+	inplace_radix_sort_impl<Trait::radix_size - 1, Trait>(first, second);
+}
+
+template <typename Iter>
+void inplace_radix_sort(Iter first, Iter second)
+{
+	inplace_radix_sort<radix_trait<typename std::iterator_traits<Iter>::value_type>>(first, second);
+}
+
+template <typename Trait, typename Iter>
+void parallel_inplace_radix_sort(Iter first, Iter second, radix_sort_context& ctx)
+{
+	using namespace std;
+	auto length = distance(first, second);
+	auto thrd_lim = ctx.thread_num(length);
+	if (thrd_lim > 1)
+	{
+		auto counter = ctx.counter<radix_counter<Trait, ptrdiff_t>>(3 * thrd_lim);
+		parallel_inplace_radix_sort_impl<Trait::radix_size - 1, Trait>(first, second, ctx.thread_pool(), thrd_lim, counter);
+	}
+	else
+		inplace_radix_sort_impl<Trait::radix_size - 1, Trait>(first, second);
+}
+
+template <typename Trait, typename Iter>
+void parallel_inplace_radix_sort(Iter first, Iter second, unsigned int thrd_lim = radix_hardware_concurrency(), radix_thread_pool& pool = radix_thread_pool::global())
+{
+	radix_sort_context ctx(thrd_lim, radix_sort_context::default_thrd_sort_length_limit, &pool);
+	parallel_inplace_radix_sort<Trait>(first, second, ctx);
+}
+
+template <typename Iter>
+void parallel_inplace_radix_sort(Iter first, Iter second, radix_sort_context& ctx)
+{
+	parallel_inplace_radix_sort<radix_trait<typename std::iterator_traits<Iter>::value_type>>(first, second, ctx);
+}
+
+template <typename Iter>
+void parallel_inplace_radix_sort(Iter first, Iter second, unsigned int thrd_lim = radix_hardware_concurrency(), radix_thread_pool& pool = radix_thread_pool::global())
+{
+	parallel_inplace_radix_sort<radix_trait<typename std::iterator_traits<Iter>::value_type>>(first, second, thrd_lim, pool);
+}
+
+template <typename Trait, typename Iter, typename ExecutionPolicy>
+	requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+void inplace_radix_sort(Iter first, Iter second, ExecutionPolicy&& policy, radix_sort_context& ctx)
+{
+	if constexpr (is_parallel_policy_v<ExecutionPolicy>)
+		parallel_inplace_radix_sort<Trait>(first, second, ctx);
+	else
+		inplace_radix_sort<Trait>(first, second);
+}
+
+template <typename Iter, typename ExecutionPolicy>
+	requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+void inplace_radix_sort(Iter first, Iter second, ExecutionPolicy&& policy, radix_sort_context& ctx)
+{
+	inplace_radix_sort<radix_trait<typename std::iterator_traits<Iter>::value_type>>(first, second, policy, ctx);
+}
+
+template <typename Iter, typename ExecutionPolicy>
+	requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+void inplace_radix_sort(Iter first, Iter second, ExecutionPolicy&& policy)
+{
+	if constexpr (is_parallel_policy_v<ExecutionPolicy>)
+		parallel_inplace_radix_sort<radix_trait<typename std::iterator_traits<Iter>::value_type>>(first, second);
+	else
+		inplace_radix_sort<radix_trait<typename std::iterator_traits<Iter>::value_type>>(first, second);
+}
+
+template <typename Trait, typename Iter, typename ExecutionPolicy>
+	requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+void inplace_radix_sort(Iter first, Iter second, ExecutionPolicy&& policy)
+{
+	if constexpr (is_parallel_policy_v<ExecutionPolicy>)
+		parallel_inplace_radix_sort<Trait>(first, second);
+	else
+		inplace_radix_sort<Trait>(first, second);
+}
+
+//three-way partition of [first,second) on digit i: digits below b first, then b, then above.
+//below and equal are the sizes of the first two parts, known from a histogram; std::partition only swaps misplaced pairs,
+//so a bucket near either end costs about one read of the range
+template <size_t i, typename Trait, typename Iter, typename cnt_type>
+void radix_partition3(Iter first, Iter second, size_t b, cnt_type below, cnt_type equal)
+{
+	if (below + equal != std::distance(first, second))
+		std::partition(first, second, [b](const auto& x) { return Trait::template get<i>(x) <= b; });
+	if (below != 0)
+		std::partition(first, first + (below + equal), [b](const auto& x) { return Trait::template get<i>(x) < b; });
+}
+
+//bucket of digit i holding position pos of the sorted range, and how many elements come before that bucket
+template <typename Trait, typename cnt_type>
+std::pair<size_t, cnt_type> radix_select_bucket(const radix_counter<Trait, cnt_type>& counter, cnt_type pos)
+{
+	size_t b = 0;
+	cnt_type below = 0;
+	while (below + counter[b] <= pos)
+		below += counter[b++];
+	return { b, below };
+}
+
+//MSD selection: only the bucket holding nth is partitioned out and visited on the next digit,
+//so the ranges shrink by about the bucket count every level
+template <size_t i, typename Trait, typename Iter>
+void radix_select_impl(Iter first, Iter nth, Iter second)
+{
+	using namespace std;
+	constexpr auto select_sort_length_limit = 64; //ranges below this are finished by std::nth_element
+	auto length = distance(first, second);
+	if (length <= select_sort_length_limit)
+	{
+		nth_element(first, nth, second, radix_less<Trait, i>{});
+		return;
+	}
+	radix_counter<Trait, ptrdiff_t> counter;
+	count_duff_device<i, Trait>(first, second, counter);
+	auto [b, below] = radix_select_bucket<Trait>(counter, nth - first);
+	if (counter[b] != length)
+		radix_partition3<i, Trait>(first, second, b, below, counter[b]);
+	if constexpr (i > 0)
+		radix_select_impl<i - 1, Trait>(first + below, nth, first + below + counter[b]);
+}
+
+//parallel MSD selection: per-chunk histograms as in parallel_radix_sort_impl, one stable scatter of digit i through
+//ctx's buffer, then only the bucket holding nth goes on to digit i - 1
+template <size_t i, typename Trait, typename Iter>
+void parallel_radix_select_impl(Iter first, Iter nth, Iter second, radix_sort_context& ctx)
+{
+	using namespace std;
+	using value_type = typename iterator_traits<Iter>::value_type;
+	constexpr auto thrd_chunk_num = 4;
+	auto length = distance(first, second);
+	auto thrd_lim = ctx.thread_num(length);
+	if (thrd_lim <= 1)
+	{
+		radix_select_impl<i, Trait>(first, nth, second);
+		return;
+	}
+	auto& pool = ctx.thread_pool();
+	auto chunk_num = thrd_lim * thrd_chunk_num;
+	auto parallel_width = length / chunk_num;
+	auto chunk_end = [&](size_t j) { return j == chunk_num - 1 ? length : (j + 1) * parallel_width; };
+	auto counter = ctx.counter<radix_chunk_counter<Trait, ptrdiff_t>>(chunk_num);
+	pool.parallel_for(chunk_num, [&](size_t j) {
+		count_duff_device<i, Trait>(first + j * parallel_width, first + chunk_end(j), counter[j].histogram[i]);
+	}, thrd_lim);
+	merge_chunk_histograms<i>(pool, thrd_lim, chunk_num, counter);
+	auto& bucket_end = counter[0].histogram[i];
+	auto pos = nth - first;
+	size_t b = 0;
+	while (bucket_end[b] <= pos)
+		++b;
+	auto below = b ? bucket_end[b - 1] : 0;
+	auto size = bucket_end[b] - below;
+	if (size != length)
+	{
+		auto buffer = ctx.buffer<value_type>(length);
+		pool.parallel_for(chunk_num, [&](size_t j) {
+			radix_place<i, Trait>(first, buffer, chunk_offset<i>(counter, chunk_num, j), j * parallel_width, chunk_end(j), length);
+		}, thrd_lim);
+		pool.parallel_for(chunk_num, [&](size_t j) {
+			std::move(buffer + j * parallel_width, buffer + chunk_end(j), first + j * parallel_width);
+		}, thrd_lim);
+	}
+	if constexpr (i > 0)
+		parallel_radix_select_impl<i - 1, Trait>(first + below, nth, first + below + size, ctx);
+}
+
+template <typename Trait, bool parallel, typename Iter>
+void radix_nth_element_impl(Iter first, Iter nth, Iter second, radix_sort_context& ctx)
+{
+	if (nth == second)
+		return;
+	if constexpr (parallel)
+		parallel_radix_select_impl<Trait::radix_size - 1, Trait>(first, nth, second, ctx);
+	else
+		radix_select_impl<Trait::radix_size - 1, Trait>(first, nth, second);
+}
+
+//the k smallest elements in Trait order move to [first,first+k) in unspecified order
+template <typename Trait, bool parallel, typename Iter>
+Iter radix_top_k_impl(Iter first, Iter second, size_t k, radix_sort_context& ctx)
+{
+	auto length = static_cast<size_t>(std::distance(first, second));
+	if (k >= length)
+		return second;
+	radix_nth_element_impl<Trait, parallel>(first, first + k, second, ctx);
+	return first + k;
+}
+
+template <typename Trait, bool parallel, typename Iter>
+void radix_partial_sort_impl(Iter first, Iter middle, Iter second, radix_sort_context& ctx)
+{
+	radix_nth_element_impl<Trait, parallel>(first, middle, second, ctx);
+	if constexpr (parallel)
+		parallel_radix_sort<Trait>(first, middle, ctx);
+	else
+		radix_sort<Trait>(first, middle, ctx);
+}
+
+//*nth becomes the element a full sort would put there, no element before it is greater in Trait order and none after it is less
+template <typename Trait, typename Iter>
+void radix_nth_element(Iter first, Iter nth, Iter second)
+{
+	radix_sort_context ctx;
+	radix_nth_element_impl<Trait, false>(first, nth, second, ctx);
+}
+
+template <typename Iter>
+void radix_nth_element(Iter first, Iter nth, Iter second)
+{
+	radix_nth_element<radix_trait<typename std::iterator_traits<Iter>::value_type>>(first, nth, second);
+}
+
+template <typename Trait, typename Iter, typename ExecutionPolicy>
+	requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+void radix_nth_element(Iter first, Iter nth, Iter second, ExecutionPolicy&& policy, radix_sort_context& ctx)
+{
+	radix_nth_element_impl<Trait, is_parallel_policy_v<ExecutionPolicy>>(first, nth, second, ctx);
+}
+
+template <typename Trait, typename Iter, typename ExecutionPolicy>
+	requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+void radix_nth_element(Iter first, Iter nth, Iter second, ExecutionPolicy&& policy)
+{
+	radix_sort_context ctx;
+	radix_nth_element<Trait>(first, nth, second, policy, ctx);
+}
+
+template <typename Iter, typename ExecutionPolicy>
+	requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+void radix_nth_element(Iter first, Iter nth, Iter second, ExecutionPolicy&& policy, radix_sort_context& ctx)
+{
+	radix_nth_element<radix_trait<typename std::iterator_traits<Iter>::value_type>>(first, nth, second, policy, ctx);
+}
+
+template <typename Iter, typename ExecutionPolicy>
+	requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+void radix_nth_element(Iter first, Iter nth, Iter second, ExecutionPolicy&& policy)
+{
+	radix_nth_element<radix_trait<typename std::iterator_traits<Iter>::value_type>>(first, nth, second, policy);
+}
+
+//the middle - first smallest elements in Trait order, sorted, then the rest in unspecified order
+template <typename Trait, typename Iter>
+void radix_partial_sort(Iter first, Iter middle, Iter second)
+{
+	radix_sort_context ctx;
+	radix_partial_sort_impl<Trait, false>(first, middle, second, ctx);
+}
+
+template <typename Iter>
+void radix_partial_sort(Iter first, Iter middle, Iter second)
+{
+	radix_partial_sort<radix_trait<typename std::iterator_traits<Iter>::value_type>>(first, middle, second);
+}
+
+template <typename Trait, typename Iter, typename ExecutionPolicy>
+	requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+void radix_partial_sort(Iter first, Iter middle, Iter second, ExecutionPolicy&& policy, radix_sort_context& ctx)
+{
+	radix_partial_sort_impl<Trait, is_parallel_policy_v<ExecutionPolicy>>(first, middle, second, ctx);
+}
+
+template <typename Trait, typename Iter, typename ExecutionPolicy>
+	requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+void radix_partial_sort(Iter first, Iter middle, Iter second, ExecutionPolicy&& policy)
+{
+	radix_sort_context ctx;
+	radix_partial_sort<Trait>(first, middle, second, policy, ctx);
+}
+
+template <typename Iter, typename ExecutionPolicy>
+	requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+void radix_partial_sort(Iter first, Iter middle, Iter second, ExecutionPolicy&& policy, radix_sort_context& ctx)
+{
+	radix_partial_sort<radix_trait<typename std::iterator_traits<Iter>::value_type>>(first, middle, second, policy, ctx);
+}
+
+template <typename Iter, typename ExecutionPolicy>
+	requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+void radix_partial_sort(Iter first, Iter middle, Iter second, ExecutionPolicy&& policy)
+{
+	radix_partial_sort<radix_trait<typename std::iterator_traits<Iter>::value_type>>(first, middle, second, policy);
+}
+
+//move the k smallest elements in Trait order to the front in unspecified order and return the end of them,
+//radix_trait_greater gives the k largest
+template <typename Trait, typename Iter>
+Iter radix_top_k(Iter first, Iter second, size_t k)
+{
+	radix_sort_context ctx;
+	return radix_top_k_impl<Trait, false>(first, second, k, ctx);
+}
+
+template <typename Iter>
+Iter radix_top_k(Iter first, Iter second, size_t k)
+{
+	return radix_top_k<radix_trait<typename std::iterator_traits<Iter>::value_type>>(first, second, k);
+}
+
+template <typename Trait, typename Iter, typename ExecutionPolicy>
+	requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+Iter radix_top_k(Iter first, Iter second, size_t k, ExecutionPolicy&& policy, radix_sort_context& ctx)
+{
+	return radix_top_k_impl<Trait, is_parallel_policy_v<ExecutionPolicy>>(first, second, k, ctx);
+}
+
+template <typename Trait, typename Iter, typename ExecutionPolicy>
+	requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+Iter radix_top_k(Iter first, Iter second, size_t k, ExecutionPolicy&& policy)
+{
+	radix_sort_context ctx;
+	return radix_top_k<Trait>(first, second, k, policy, ctx);
+}
+
+template <typename Iter, typename ExecutionPolicy>
+	requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+Iter radix_top_k(Iter first, Iter second, size_t k, ExecutionPolicy&& policy, radix_sort_context& ctx)
+{
+	return radix_top_k<radix_trait<typename std::iterator_traits<Iter>::value_type>>(first, second, k, policy, ctx);
+}
+
+template <typename Iter, typename ExecutionPolicy>
+	requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+Iter radix_top_k(Iter first, Iter second, size_t k, ExecutionPolicy&& policy)
+{
+	return radix_top_k<radix_trait<typename std::iterator_traits<Iter>::value_type>>(first, second, k, policy);
+}
+
+//digits [lo,hi) of a trait, counted from the least significant one, that radix_partition groups by
+template <size_t lo, size_t hi = lo + 1>
+struct radix_digit_range
+{
+	static_assert(lo < hi && hi - lo <= 2, "radix_partition makes one scatter pass per digit");
+	static constexpr size_t first = lo, last = hi;
+};
+
+//one stable scatter of length elements from src to dst on digit i, returns the end of every bucket in dst.
+//in parallel every chunk of src fills one contiguous slice of each bucket, as in parallel_radix_sort_impl
+template <size_t i, typename Trait, bool parallel, typename SrcIter, typename DstIter>
+radix_counter<Trait, size_t> radix_scatter_pass(SrcIter src, DstIter dst, size_t length, radix_sort_context& ctx)
+{
+	using namespace std;
+	constexpr auto thrd_chunk_num = 4;
+	auto thrd_lim = parallel ? ctx.thread_num(length) : 1u;
+	if (thrd_lim > 1)
+	{
+		auto& pool = ctx.thread_pool();
+		auto chunk_num = thrd_lim * thrd_chunk_num;
+		auto parallel_width = length / chunk_num;
+		auto chunk_end = [&](size_t j) { return j == chunk_num - 1 ? length : (j + 1) * parallel_width; };
+		auto counter = ctx.counter<radix_chunk_counter<Trait, size_t>>(chunk_num);
+		pool.parallel_for(chunk_num, [&](size_t j) {
+			count_duff_device<i, Trait>(src + j * parallel_width, src + chunk_end(j), counter[j].histogram[i]);
+		}, thrd_lim);
+		merge_chunk_histograms<i>(pool, thrd_lim, chunk_num, counter);
+		pool.parallel_for(chunk_num, [&](size_t j) {
+			radix_place<i, Trait>(src, dst, chunk_offset<i>(counter, chunk_num, j), j * parallel_width, chunk_end(j), length);
+		}, thrd_lim);
+		return counter[0].histogram[i];
+	}
+	radix_counter<Trait, size_t> counter;
+	count_duff_device<i, Trait>(src, src + length, counter);
+	for (size_t k = 1; k < radix_bucket_num_v<Trait>; ++k)
+		counter[k] += counter[k - 1];
+	auto bucket_end = counter;
+	radix_place<i, Trait>(src, dst, counter, 0, length, length);
+	return bucket_end;
+}
+
+template <typename Trait, typename Range, bool parallel, typename Iter, typename OutIter>
+std::vector<size_t> radix_partition_impl(Iter first, Iter second, OutIter out, radix_sort_context& ctx)
+{
+	using namespace std;
+	using value_type = typename iterator_traits<Iter>::value_type;
+	constexpr auto lo = Range::first, hi = Range::last;
+	constexpr auto bucket_num = radix_bucket_num_v<Trait>;
+	static_assert(hi <= Trait::radix_size);
+	size_t length = distance(first, second);
+	vector<size_t> offset((size_t(1) << ((hi - lo) * radix_digit_bits_v<Trait>)) + 1);
+	if constexpr (hi - lo == 1)
+	{
+		auto bucket_end = radix_scatter_pass<lo, Trait, parallel>(first, out, length, ctx);
+		copy(bucket_end.begin(), bucket_end.end(), offset.begin() + 1);
+	}
+	else
+	{
+		//two LSD passes through ctx's buffer: out ends up grouped by digit lo + 1 and, inside that, ordered by digit lo
+		auto buffer = ctx.buffer<value_type>(length);
+		radix_scatter_pass<lo, Trait, parallel>(first, buffer, length, ctx);
+		auto bucket_end = radix_scatter_pass<lo + 1, Trait, parallel>(buffer, out, length, ctx);
+		for (size_t h = 0; h < bucket_num; ++h)
+		{
+			auto beg = out + (h ? bucket_end[h - 1] : 0), end = out + bucket_end[h];
+			for (size_t k = 1; k < bucket_num; ++k)
+				offset[h * bucket_num + k] = partition_point(beg, end, [k](const auto& x) { return size_t(Trait::template get<lo>(x)) < k; }) - out;
+			offset[(h + 1) * bucket_num] = bucket_end[h];
+		}
+	}
+	return offset;
+}
+
+//move [first,second) to out grouped by digits [Range::first,Range::last) of Trait, equal digits keep their input order.
+//returns the bucket offsets: bucket k, whose key is the digits read as one number, is out[offset[k], offset[k + 1]).
+//one digit takes one scatter pass, two digits take two through ctx's buffer. a trait whose digits are a hash partitions by hash
+template <typename Trait, typename Iter, typename OutIter, typename Range>
+std::vector<size_t> radix_partition(Iter first, Iter second, OutIter out, Range)
+{
+	radix_sort_context ctx;
+	return radix_partition_impl<Trait, Range, false>(first, second, out, ctx);
+}
+
+template <typename Iter, typename OutIter, typename Range>
+std::vector<size_t> radix_partition(Iter first, Iter second, OutIter out, Range range)
+{
+	return radix_partition<radix_trait<typename std::iterator_traits<Iter>::value_type>>(first, second, out, range);
+}
+
+template <typename Trait, typename Iter, typename OutIter, typename Range, typename ExecutionPolicy>
+	requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+std::vector<size_t> radix_partition(Iter first, Iter second, OutIter out, Range, ExecutionPolicy&& policy, radix_sort_context& ctx)
+{
+	return radix_partition_impl<Trait, Range, is_parallel_policy_v<ExecutionPolicy>>(first, second, out, ctx);
+}
+
+template <typename Trait, typename Iter, typename OutIter, typename Range, typename ExecutionPolicy>
+	requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+std::vector<size_t> radix_partition(Iter first, Iter second, OutIter out, Range range, ExecutionPolicy&& policy)
+{
+	radix_sort_context ctx;
+	return radix_partition<Trait>(first, second, out, range, policy, ctx);
+}
+
+template <typename Iter, typename OutIter, typename Range, typename ExecutionPolicy>
+	requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+std::vector<size_t> radix_partition(Iter first, Iter second, OutIter out, Range range, ExecutionPolicy&& policy, radix_sort_context& ctx)
+{
+	return radix_partition<radix_trait<typename std::iterator_traits<Iter>::value_type>>(first, second, out, range, policy, ctx);
+}
+
+template <typename Iter, typename OutIter, typename Range, typename ExecutionPolicy>
+	requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+std::vector<size_t> radix_partition(Iter first, Iter second, OutIter out, Range range, ExecutionPolicy&& policy)
+{
+	return radix_partition<radix_trait<typename std::iterator_traits<Iter>::value_type>>(first, second, out, range, policy);
+}
+
+//one counting pass of short [first,first+length) on digit i through buffer. returns false, having moved nothing,
+//when a bucket keeps more than crowded_limit elements whose lower digits still differ
+template <size_t i, typename Trait, typename Iter>
+bool radix_spread_pass(Iter first, std::ptrdiff_t length, typename std::iterator_traits<Iter>::value_type* buffer, std::ptrdiff_t crowded_limit)
+{
+	using namespace std;
+	radix_counter<Trait, int> counter;
+	count_duff_device<i, Trait>(first, first + length, counter);
+	if (i > 0 && *max_element(counter.begin(), counter.end()) > crowded_limit)
+		return false;
+	for (size_t j = 1; j < radix_bucket_num_v<Trait>; ++j)
+		counter[j] += counter[j - 1];
+	place_duff_device<i, Trait>(first, buffer, counter, 0, length);
+	std::move(buffer, buffer + length, first);
+	return true;
+}
+
+//sort a short range: one counting pass on the most significant digit that is not the same everywhere leaves buckets
+//small enough for an insertion sort. a range whose buckets stay crowded takes the LSD passes of radix_sort_impl instead
+template <typename Trait, typename Iter>
+void radix_small_sort(Iter first, Iter second, typename std::iterator_traits<Iter>::value_type* buffer)
+{
+	using namespace std;
+	constexpr ptrdiff_t insertion_sort_length_limit = 16, crowded_bucket_limit = 16;
+	constexpr auto radix_size = Trait::radix_size;
+	auto length = distance(first, second);
+	if (length <= insertion_sort_length_limit)
+		return radix_insertion_sort<Trait>(first, second);
+	size_t top = radix_size - 1;
+	if constexpr (radix_size * radix_digit_bits_v<Trait> <= 64)
+	{
+		//the highest bit in which any key differs from the first one
+		auto key = radix_pack<Trait>(*first, make_index_sequence<radix_size>{});
+		uint64_t diff = 0;
+		for (auto it = next(first); it != second; ++it)
+			diff |= radix_pack<Trait>(*it, make_index_sequence<radix_size>{}) ^ key;
+		if (diff == 0)
+			return;
+		top = (bit_width(diff) - 1) / radix_digit_bits_v<Trait>;
+	}
+	bool spread = false;
+	[&]<size_t... i>(index_sequence<i...>) {
+		((i == top && (spread = radix_spread_pass<i, Trait>(first, length, buffer, crowded_bucket_limit))), ...);
+	}(make_index_sequence<radix_size>{});
+	if (spread)
+		radix_insertion_sort<Trait>(first, second);
+	else
+	{
+		radix_histograms<Trait, int> counter;
+		radix_sort_impl<0, Trait>(first, second, buffer, counter);
+	}
+}
+
+//sort [data+offsets[s],data+offsets[s+1]) for every s in [0,num_segments), stable within each segment.
+//segments up to ctx.segment_sort_length_limit go through radix_small_sort, longer ones through the LSD passes.
+//in parallel, segments holding more than 1/thrd_lim of the elements are sorted one after the other by every thread,
+//the rest are cut into tasks of about equal element counts by a binary search on offsets
+template <typename Trait, bool parallel, typename Iter, typename OffsetIter>
+void segmented_radix_sort_impl(Iter data, OffsetIter offsets, size_t num_segments, radix_sort_context& ctx)
+{
+	using namespace std;
+	using value_type = typename iterator_traits<Iter>::value_type;
+	constexpr size_t thrd_task_num = 8; //tasks per thread, so idle threads have something to steal
+	if (num_segments == 0)
+		return;
+	size_t base = offsets[0], total = offsets[num_segments] - base;
+	auto thrd_lim = parallel ? ctx.thread_num(total) : 1u;
+
+	auto sort_segment = [&](size_t s, value_type* buffer, radix_histograms<Trait, int>& counter) {
+		auto first = data + offsets[s], second = data + offsets[s + 1];
+		size_t length = second - first;
+		if (length <= ctx.segment_sort_length_limit)
+			radix_small_sort<Trait>(first, second, buffer);
+		else if (length <= INT_MAX)
+			radix_sort_impl<0, Trait>(first, second, buffer, counter);
+		else
+			radix_sort<Trait>(first, second, buffer, ctx);
+	};
+
+	if (thrd_lim <= 1)
+	{
+		size_t max_length = 0;
+		for (size_t s = 0; s < num_segments; ++s)
+			max_length = max<size_t>(max_length, offsets[s + 1] - offsets[s]);
+		auto buffer = ctx.buffer<value_type>(max_length);
+		radix_histograms<Trait, int> counter;
+		for (size_t s = 0; s < num_segments; ++s)
+			sort_segment(s, buffer, counter);
+		return;
+	}
+
+	//every segment sorts through its own slice of one shared buffer
+	auto buffer = ctx.buffer<value_type>(total);
+	for (size_t s = 0; s < num_segments; ++s)
+		if (size_t length = offsets[s + 1] - offsets[s]; length * thrd_lim > total)
+			parallel_radix_sort<Trait>(data + offsets[s], data + offsets[s + 1], buffer + (offsets[s] - base), ctx);
+	size_t task_num = thrd_lim * thrd_task_num, task_length = (total + task_num - 1) / task_num;
+	ctx.thread_pool().parallel_for(task_num, [&](size_t t) {
+		//the segments starting in [t*task_length,(t+1)*task_length)
+		auto beg = lower_bound(offsets, offsets + num_segments, base + t * task_length) - offsets;
+		auto end = lower_bound(offsets + beg, offsets + num_segments, base + (t + 1) * task_length) - offsets;
+		radix_histograms<Trait, int> counter;
+		for (auto s = beg; s < end; ++s)
+			if (size_t length = offsets[s + 1] - offsets[s]; length * thrd_lim <= total)
+				sort_segment(s, buffer + (offsets[s] - base), counter);
+	}, thrd_lim);
+}
+
+template <typename Trait, typename Iter, typename OffsetIter>
+void segmented_radix_sort(Iter data, OffsetIter offsets, size_t num_segments, radix_sort_context& ctx)
+{
+	segmented_radix_sort_impl<Trait, false>(data, offsets, num_segments, ctx);
+}
+
+template <typename Trait, typename Iter, typename OffsetIter>
+void segmented_radix_sort(Iter data, OffsetIter offsets, size_t num_segments)
+{
+	radix_sort_context ctx;
+	segmented_radix_sort<Trait>(data, offsets, num_segments, ctx);
+}
+
+template <typename Iter, typename OffsetIter>
+void segmented_radix_sort(Iter data, OffsetIter offsets, size_t num_segments, radix_sort_context& ctx)
+{
+	segmented_radix_sort<radix_trait<typename std::iterator_traits<Iter>::value_type>>(data, offsets, num_segments, ctx);
+}
+
+template <typename Iter, typename OffsetIter>
+void segmented_radix_sort(Iter data, OffsetIter offsets, size_t num_segments)
+{
+	segmented_radix_sort<radix_trait<typename std::iterator_traits<Iter>::value_type>>(data, offsets, num_segments);
+}
+
+template <typename Trait, typename Iter, typename OffsetIter, typename ExecutionPolicy>
+	requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+void segmented_radix_sort(Iter data, OffsetIter offsets, size_t num_segments, ExecutionPolicy&& policy, radix_sort_context& ctx)
+{
+	segmented_radix_sort_impl<Trait, is_parallel_policy_v<ExecutionPolicy>>(data, offsets, num_segments, ctx);
+}
+
+template <typename Trait, typename Iter, typename OffsetIter, typename ExecutionPolicy>
+	requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+void segmented_radix_sort(Iter data, OffsetIter offsets, size_t num_segments, ExecutionPolicy&& policy)
+{
+	radix_sort_context ctx;
+	segmented_radix_sort<Trait>(data, offsets, num_segments, policy, ctx);
+}
+
+template <typename Iter, typename OffsetIter, typename ExecutionPolicy>
+	requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+void segmented_radix_sort(Iter data, OffsetIter offsets, size_t num_segments, ExecutionPolicy&& policy, radix_sort_context& ctx)
+{
+	segmented_radix_sort<radix_trait<typename std::iterator_traits<Iter>::value_type>>(data, offsets, num_segments, policy, ctx);
+}
+
+template <typename Iter, typename OffsetIter, typename ExecutionPolicy>
+	requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+void segmented_radix_sort(Iter data, OffsetIter offsets, size_t num_segments, ExecutionPolicy&& policy)
+{
+	segmented_radix_sort<radix_trait<typename std::iterator_traits<Iter>::value_type>>(data, offsets, num_segments, policy);
+}
+
+//merge path: how many of the first d elements of the merge of sorted [a,a+a_len) and [b,b+b_len) come from a,
+//elements of a go first on equal keys
+template <typename Trait, typename AIter, typename BIter>
+size_t radix_merge_path(AIter a, size_t a_len, BIter b, size_t b_len, size_t d)
+{
+	radix_less<Trait> less;
+	size_t lo = d > b_len ? d - b_len : 0, hi = std::min(d, a_len);
+	while (lo < hi)
+	{
+		auto mid = lo + (hi - lo) / 2;
+		if (less(b[d - mid - 1], a[mid]))
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+	return lo;
+}
+
+//std::merge in Trait's order with every thread: the output is cut into equal parts and radix_merge_path finds
+//where each part starts in both inputs, so the parts are merged independently
+template <typename Trait, typename AIter, typename BIter, typename OutIter>
+void parallel_radix_merge(AIter a, size_t a_len, BIter b, size_t b_len, OutIter out, radix_thread_pool& pool, unsigned int thrd_lim)
+{
+	using namespace std;
+	constexpr size_t thrd_task_num = 4; //tasks per thread, so idle threads have something to steal
+	size_t length = a_len + b_len, task_num = thrd_lim * thrd_task_num;
+	pool.parallel_for(task_num, [&](size_t t) {
+		size_t d0 = length * t / task_num, d1 = length * (t + 1) / task_num;
+		size_t i0 = radix_merge_path<Trait>(a, a_len, b, b_len, d0), i1 = radix_merge_path<Trait>(a, a_len, b, b_len, d1);
+		merge(a + i0, a + i1, b + (d0 - i0), b + (d1 - i1), out + d0, radix_less<Trait>{});
+	}, thrd_lim);
+}
+
+//sort the batch [batch_first,batch_last) in place, then merge it with sorted [sorted_first,sorted_last) into out.
+//stable, an element of the sorted range comes before an equal one of the batch
+template <typename Trait, bool parallel, typename SortedIter, typename BatchIter, typename OutIter>
+OutIter radix_sort_merge_impl(SortedIter sorted_first, SortedIter sorted_last, BatchIter batch_first, BatchIter batch_last, OutIter out, radix_sort_context& ctx)
+{
+	using namespace std;
+	size_t sorted_len = distance(sorted_first, sorted_last), batch_len = distance(batch_first, batch_last);
+	if constexpr (parallel)
+		parallel_radix_sort<Trait>(batch_first, batch_last, nullptr, ctx);
+	else
+		radix_sort<Trait>(batch_first, batch_last, nullptr, ctx);
+	auto thrd_lim = parallel ? ctx.thread_num(sorted_len + batch_len) : 1u;
+	if (thrd_lim <= 1)
+		return merge(sorted_first, sorted_last, batch_first, batch_last, out, radix_less<Trait>{});
+	parallel_radix_merge<Trait>(sorted_first, sorted_len, batch_first, batch_len, out, ctx.thread_pool(), thrd_lim);
+	return out + (sorted_len + batch_len);
+}
+
+//in place form: [first,middle) is sorted, [middle,last) is the batch and buffer has room for last - middle elements.
+//only the sorted elements greater than the batch's smallest move, in parallel they and the batch are staged in
+//ctx's buffer and buffer first, so that the merge path parts never overwrite what another part still reads
+template <typename Trait, bool parallel, typename Iter>
+void radix_sort_merge_impl(Iter first, Iter middle, Iter last, typename std::iterator_traits<Iter>::value_type* buffer, radix_sort_context& ctx)
+{
+	using namespace std;
+	using value_type = typename iterator_traits<Iter>::value_type;
+	if constexpr (parallel)
+		parallel_radix_sort<Trait>(middle, last, buffer, ctx);
+	else
+		radix_sort<Trait>(middle, last, buffer, ctx);
+	if (first == middle || middle == last)
+		return;
+	auto moved_first = upper_bound(first, middle, *middle, radix_less<Trait>{});
+	size_t moved_len = middle - moved_first, batch_len = last - middle;
+	auto thrd_lim = parallel ? ctx.thread_num(moved_len + batch_len) : 1u;
+	if (thrd_lim <= 1)
+	{
+		if (buffer == nullptr)
+			buffer = ctx.buffer<value_type>(batch_len);
+		radix_merge_tail<Trait>(moved_first, middle, last, buffer);
+		return;
+	}
+	auto scratch = ctx.buffer<value_type>(moved_len + (buffer ? 0 : batch_len));
+	if (buffer == nullptr)
+		buffer = scratch + moved_len;
+	size_t stage_len = moved_len + batch_len, task_num = thrd_lim;
+	ctx.thread_pool().parallel_for(task_num, [&](size_t t) {
+		size_t d0 = stage_len * t / task_num, d1 = stage_len * (t + 1) / task_num;
+		if (d0 < moved_len)
+			std::move(moved_first + d0, moved_first + min(d1, moved_len), scratch + d0);
+		if (d1 > moved_len)
+			std::move(middle + (max(d0, moved_len) - moved_len), middle + (d1 - moved_len), buffer + (max(d0, moved_len) - moved_len));
+	}, thrd_lim);
+	parallel_radix_merge<Trait>(make_move_iterator(scratch), moved_len, make_move_iterator(buffer), batch_len, moved_first, ctx.thread_pool(), thrd_lim);
+}
+
+//the fifth argument of radix_sort_merge is an output iterator unless it is a context or an execution policy
+template <typename T>
+constexpr bool radix_is_merge_output_v = !std::is_execution_policy_v<std::remove_cvref_t<T>> && !std::is_same_v<std::remove_cvref_t<T>, radix_sort_context>;
+
+//radix sort only the new batch [batch_first,batch_last), which is sorted in place, and merge it with the already
+//sorted [sorted_first,sorted_last) into out, comparing by the digits of Trait. returns the end of the output
+template <typename Trait, typename SortedIter, typename BatchIter, typename OutIter>
+	requires radix_is_merge_output_v<OutIter>
+OutIter radix_sort_merge(SortedIter sorted_first, SortedIter sorted_last, BatchIter batch_first, BatchIter batch_last, OutIter out, radix_sort_context& ctx)
+{
+	return radix_sort_merge_impl<Trait, false>(sorted_first, sorted_last, batch_first, batch_last, out, ctx);
+}
+
+template <typename Trait, typename SortedIter, typename BatchIter, typename OutIter>
+	requires radix_is_merge_output_v<OutIter>
+OutIter radix_sort_merge(SortedIter sorted_first, SortedIter sorted_last, BatchIter batch_first, BatchIter batch_last, OutIter out)
+{
+	radix_sort_context ctx;
+	return radix_sort_merge<Trait>(sorted_first, sorted_last, batch_first, batch_last, out, ctx);
+}
+
+template <typename SortedIter, typename BatchIter, typename OutIter>
+	requires radix_is_merge_output_v<OutIter>
+OutIter radix_sort_merge(SortedIter sorted_first, SortedIter sorted_last, BatchIter batch_first, BatchIter batch_last, OutIter out, radix_sort_context& ctx)
+{
+	return radix_sort_merge<radix_trait<typename std::iterator_traits<BatchIter>::value_type>>(sorted_first, sorted_last, batch_first, batch_last, out, ctx);
+}
+
+template <typename SortedIter, typename BatchIter, typename OutIter>
+	requires radix_is_merge_output_v<OutIter>
+OutIter radix_sort_merge(SortedIter sorted_first, SortedIter sorted_last, BatchIter batch_first, BatchIter batch_last, OutIter out)
+{
+	return radix_sort_merge<radix_trait<typename std::iterator_traits<BatchIter>::value_type>>(sorted_first, sorted_last, batch_first, batch_last, out);
+}
+
+template <typename Trait, typename SortedIter, typename BatchIter, typename OutIter, typename ExecutionPolicy>
+	requires radix_is_merge_output_v<OutIter> && std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+OutIter radix_sort_merge(SortedIter sorted_first, SortedIter sorted_last, BatchIter batch_first, BatchIter batch_last, OutIter out, ExecutionPolicy&& policy, radix_sort_context& ctx)
+{
+	return radix_sort_merge_impl<Trait, is_parallel_policy_v<ExecutionPolicy>>(sorted_first, sorted_last, batch_first, batch_last, out, ctx);
+}
+
+template <typename Trait, typename SortedIter, typename BatchIter, typename OutIter, typename ExecutionPolicy>
+	requires radix_is_merge_output_v<OutIter> && std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+OutIter radix_sort_merge(SortedIter sorted_first, SortedIter sorted_last, BatchIter batch_first, BatchIter batch_last, OutIter out, ExecutionPolicy&& policy)
+{
+	radix_sort_context ctx;
+	return radix_sort_merge<Trait>(sorted_first, sorted_last, batch_first, batch_last, out, policy, ctx);
+}
+
+template <typename SortedIter, typename BatchIter, typename OutIter, typename ExecutionPolicy>
+	requires radix_is_merge_output_v<OutIter> && std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+OutIter radix_sort_merge(SortedIter sorted_first, SortedIter sorted_last, BatchIter batch_first, BatchIter batch_last, OutIter out, ExecutionPolicy&& policy, radix_sort_context& ctx)
+{
+	return radix_sort_merge<radix_trait<typename std::iterator_traits<BatchIter>::value_type>>(sorted_first, sorted_last, batch_first, batch_last, out, policy, ctx);
+}
+
+template <typename SortedIter, typename BatchIter, typename OutIter, typename ExecutionPolicy>
+	requires radix_is_merge_output_v<OutIter> && std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+OutIter radix_sort_merge(SortedIter sorted_first, SortedIter sorted_last, BatchIter batch_first, BatchIter batch_last, OutIter out, ExecutionPolicy&& policy)
+{
+	return radix_sort_merge<radix_trait<typename std::iterator_traits<BatchIter>::value_type>>(sorted_first, sorted_last, batch_first, batch_last, out, policy);
+}
+
+//in place: [first,middle) is sorted, the batch [middle,last) is radix sorted and merged in, buffer has room for
+//last - middle elements, nullptr takes it from ctx
+template <typename Trait, typename Iter>
+void radix_sort_merge(Iter first, Iter middle, Iter last, typename std::iterator_traits<Iter>::value_type* buffer, radix_sort_context& ctx)
+{
+	radix_sort_merge_impl<Trait, false>(first, middle, last, buffer, ctx);
+}
+
+template <typename Trait, typename Iter>
+void radix_sort_merge(Iter first, Iter middle, Iter last, typename std::iterator_traits<Iter>::value_type* buffer = nullptr)
+{
+	radix_sort_context ctx;
+	radix_sort_merge<Trait>(first, middle, last, buffer, ctx);
+}
+
+template <typename Iter>
+void radix_sort_merge(Iter first, Iter middle, Iter last, typename std::iterator_traits<Iter>::value_type* buffer, radix_sort_context& ctx)
+{
+	radix_sort_merge<radix_trait<typename std::iterator_traits<Iter>::value_type>>(first, middle, last, buffer, ctx);
+}
+
+template <typename Iter>
+void radix_sort_merge(Iter first, Iter middle, Iter last, typename std::iterator_traits<Iter>::value_type* buffer = nullptr)
+{
+	radix_sort_merge<radix_trait<typename std::iterator_traits<Iter>::value_type>>(first, middle, last, buffer);
+}
+
+template <typename Trait, typename Iter, typename ExecutionPolicy>
+	requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+void radix_sort_merge(Iter first, Iter middle, Iter last, typename std::iterator_traits<Iter>::value_type* buffer, ExecutionPolicy&& policy, radix_sort_context& ctx)
+{
+	radix_sort_merge_impl<Trait, is_parallel_policy_v<ExecutionPolicy>>(first, middle, last, buffer, ctx);
+}
+
+template <typename Trait, typename Iter, typename ExecutionPolicy>
+	requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+void radix_sort_merge(Iter first, Iter middle, Iter last, typename std::iterator_traits<Iter>::value_type* buffer, ExecutionPolicy&& policy)
+{
+	radix_sort_context ctx;
+	radix_sort_merge<Trait>(first, middle, last, buffer, policy, ctx);
+}
+
+template <typename Iter, typename ExecutionPolicy>
+	requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+void radix_sort_merge(Iter first, Iter middle, Iter last, typename std::iterator_traits<Iter>::value_type* buffer, ExecutionPolicy&& policy, radix_sort_context& ctx)
+{
+	radix_sort_merge<radix_trait<typename std::iterator_traits<Iter>::value_type>>(first, middle, last, buffer, policy, ctx);
+}
+
+template <typename Iter, typename ExecutionPolicy>
+	requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+void radix_sort_merge(Iter first, Iter middle, Iter last, typename std::iterator_traits<Iter>::value_type* buffer, ExecutionPolicy&& policy)
+{
+	radix_sort_merge<radix_trait<typename std::iterator_traits<Iter>::value_type>>(first, middle, last, buffer, policy);
+}
+
+//digits of one element and its position, sorted in place of elements too large to move every pass
+template <typename Trait, typename index_type>
+struct radix_index_key
+{
+	std::array<radix_digit_t<radix_digit_bits_v<Trait>>, Trait::radix_size> digit;
+	index_type index;
+};
+
+template <typename Trait, typename index_type>
+struct radix_index_trait
+{
+	static constexpr std::size_t digit_bits = radix_digit_bits_v<Trait>;
+	static constexpr std::size_t radix_size = Trait::radix_size;
+	template <size_t index>
+	static radix_digit_t<digit_bits> get(const radix_index_key<Trait, index_type>& obj) noexcept
+	{
+		return obj.digit[index];
+	}
+};
+
+//call func(pos_beg, pos_end) over [0,length), split across the context's threads when parallel
+template <bool parallel, typename Func>
+void radix_for_each_chunk(radix_sort_context& ctx, size_t length, Func&& func)
+{
+	constexpr auto thrd_chunk_num = 4;
+	auto thrd_lim = parallel ? ctx.thread_num(length) : 1u;
+	if (thrd_lim > 1)
+	{
+		auto chunk_num = thrd_lim * thrd_chunk_num;
+		ctx.thread_pool().parallel_for(chunk_num, [&](size_t j) {
+			func(length * j / chunk_num, length * (j + 1) / chunk_num);
+		}, thrd_lim);
+	}
+	else
+		func(size_t(0), length);
+}
+
+template <typename Trait, typename Iter, typename index_type, size_t... i>
+void radix_extract_keys(Iter first, size_t pos_beg, size_t pos_end, radix_index_key<Trait, index_type>* key, std::index_sequence<i...>)
+{
+	for (auto j = pos_beg; j < pos_end; ++j)
+	{
+		const auto& obj = first[j];
+		key[j] = { { static_cast<radix_digit_t<radix_digit_bits_v<Trait>>>(Trait::template get<i>(obj))... }, static_cast<index_type>(j) };
+	}
+}
+
+//sort the (digits, index) records of [first,second) and hand them to func, the records live in ctx's scratch
+template <typename Trait, bool parallel, typename Iter, typename Func>
+void radix_sort_index_keys(Iter first, Iter second, radix_sort_context& ctx, Func&& func)
+{
+	using namespace std;
+	auto sort_keys = [&](auto index) {
+		using key_type = radix_index_key<Trait, typename decltype(index)::type>;
+		using key_trait = radix_index_trait<Trait, typename decltype(index)::type>;
+		size_t length = distance(first, second);
+		auto key = ctx.buffer<key_type>(2 * length);
+		radix_for_each_chunk<parallel>(ctx, length, [&](size_t pos_beg, size_t pos_end) {
+			radix_extract_keys<Trait>(first, pos_beg, pos_end, key, make_index_sequence<Trait::radix_size>{});
+		});
+		if constexpr (parallel)
+			parallel_radix_sort<key_trait>(key, key + length, key + length, ctx);
+		else
+			radix_sort<key_trait>(key, key + length, key + length, ctx);
+		func(key, length);
+	};
+	if (distance(first, second) <= INT_MAX) //32-bit indices, like the int counters
+		sort_keys(type_identity<uint32_t>{});
+	else
+		sort_keys(type_identity<size_t>{});
+}
+
+//out[k] becomes the position in [first,second) of the k-th element in sorted order, ties keep their input order
+template <typename Trait, bool parallel, typename Iter, typename IndexIter>
+void radix_argsort_impl(Iter first, Iter second, IndexIter out, radix_sort_context& ctx)
+{
+	radix_sort_index_keys<Trait, parallel>(first, second, ctx, [&](auto key, size_t length) {
+		radix_for_each_chunk<parallel>(ctx, length, [&](size_t pos_beg, size_t pos_end) {
+			for (auto k = pos_beg; k < pos_end; ++k)
+				out[k] = static_cast<typename std::iterator_traits<IndexIter>::value_type>(key[k].index);
+		});
+	});
+}
+
+//sort by index records, then move every element once by following the permutation's cycles (a serial pass)
+template <typename Trait, bool parallel, typename Iter>
+void indirect_radix_sort_impl(Iter first, Iter second, radix_sort_context& ctx)
+{
+	radix_sort_index_keys<Trait, parallel>(first, second, ctx, [&](auto key, size_t length) {
+		radix_permute_by_index(first, key, length);
+	});
+}
+
+template <typename Trait, bool parallel, typename Iter, typename OutIter>
+void indirect_radix_sort_copy_impl(Iter first, Iter second, OutIter d_first, radix_sort_context& ctx)
+{
+	radix_sort_index_keys<Trait, parallel>(first, second, ctx, [&](auto key, size_t length) {
+		radix_for_each_chunk<parallel>(ctx, length, [&](size_t pos_beg, size_t pos_end) {
+			for (auto k = pos_beg; k < pos_end; ++k)
+				d_first[k] = first[key[k].index];
+		});
+	});
+}
+
+template <typename Trait, typename Iter, typename IndexIter>
+void radix_argsort(Iter first, Iter second, IndexIter out, radix_sort_context& ctx)
+{
+	radix_argsort_impl<Trait, false>(first, second, out, ctx);
+}
+
+template <typename Trait, typename Iter, typename IndexIter>
+void radix_argsort(Iter first, Iter second, IndexIter out)
+{
+	radix_sort_context ctx;
+	radix_argsort_impl<Trait, false>(first, second, out, ctx);
+}
+
+template <typename Iter, typename IndexIter>
+void radix_argsort(Iter first, Iter second, IndexIter out, radix_sort_context& ctx)
+{
+	with_default_radix_trait<typename std::iterator_traits<Iter>::value_type>(std::distance(first, second), 1, [&](auto trait) {
+		radix_argsort_impl<typename decltype(trait)::type, false>(first, second, out, ctx);
+	});
+}
+
+template <typename Iter, typename IndexIter>
+void radix_argsort(Iter first, Iter second, IndexIter out)
+{
+	radix_sort_context ctx;
+	radix_argsort(first, second, out, ctx);
+}
+
+template <typename Trait, typename Iter, typename IndexIter, typename ExecutionPolicy>
+	requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+void radix_argsort(Iter first, Iter second, IndexIter out, ExecutionPolicy&& policy, radix_sort_context& ctx)
+{
+	radix_argsort_impl<Trait, is_parallel_policy_v<ExecutionPolicy>>(first, second, out, ctx);
+}
+
+template <typename Trait, typename Iter, typename IndexIter, typename ExecutionPolicy>
+	requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+void radix_argsort(Iter first, Iter second, IndexIter out, ExecutionPolicy&& policy)
+{
+	radix_sort_context ctx;
+	radix_argsort_impl<Trait, is_parallel_policy_v<ExecutionPolicy>>(first, second, out, ctx);
+}
+
+template <typename Iter, typename IndexIter, typename ExecutionPolicy>
+	requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+void radix_argsort(Iter first, Iter second, IndexIter out, ExecutionPolicy&& policy, radix_sort_context& ctx)
+{
+	auto length = std::distance(first, second);
+	with_default_radix_trait<typename std::iterator_traits<Iter>::value_type>(length, is_parallel_policy_v<ExecutionPolicy> ? ctx.thread_num(length) : 1, [&](auto trait) {
+		radix_argsort_impl<typename decltype(trait)::type, is_parallel_policy_v<ExecutionPolicy>>(first, second, out, ctx);
+	});
+}
+
+template <typename Iter, typename IndexIter, typename ExecutionPolicy>
+	requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+void radix_argsort(Iter first, Iter second, IndexIter out, ExecutionPolicy&& policy)
+{
+	radix_sort_context ctx;
+	radix_argsort(first, second, out, policy, ctx);
+}
+
+template <typename Trait, typename Iter>
+void indirect_radix_sort(Iter first, Iter second, radix_sort_context& ctx)
+{
+	indirect_radix_sort_impl<Trait, false>(first, second, ctx);
+}
+
+template <typename Trait, typename Iter>
+void indirect_radix_sort(Iter first, Iter second)
+{
+	radix_sort_context ctx;
+	indirect_radix_sort_impl<Trait, false>(first, second, ctx);
+}
 
-template <typename T>
-class radix_trait;
+template <typename Iter>
+void indirect_radix_sort(Iter first, Iter second, radix_sort_context& ctx)
+{
+	indirect_radix_sort<radix_trait<typename std::iterator_traits<Iter>::value_type>>(first, second, ctx);
+}
 
-template <typename T>
-class radix_trait_greater;
+template <typename Iter>
+void indirect_radix_sort(Iter first, Iter second)
+{
+	indirect_radix_sort<radix_trait<typename std::iterator_traits<Iter>::value_type>>(first, second);
+}
 
-template<size_t i, typename Trait, typename Iter, typename cnt_type>
-void count_duff_device(Iter begin, Iter end, std::array<cnt_type, std::numeric_limits<unsigned char>::max() + 1 >& counter)
+template <typename Trait, typename Iter, typename ExecutionPolicy>
+	requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+void indirect_radix_sort(Iter first, Iter second, ExecutionPolicy&& policy, radix_sort_context& ctx)
 {
-	if constexpr (i > 0)
-		memset(counter.data(), 0, sizeof(counter));
-	auto length = std::distance(begin, end);
-	if (length == 0)
-		return;
-	//We should take care of iterator to avoid it out range of [begin,end], or we may face assertion in debug mode
-	auto diff = (length % 4 + 3) % 4;
-	begin += diff;
-	end -= 1;
-	switch (diff) //Dear duff device
-	{
-		for (;; begin += 4)
-		{
-	[[fallthrough]]; case 3:++counter[Trait::template get<i>(*(begin - 3))];
-	[[fallthrough]]; case 2:++counter[Trait::template get<i>(*(begin - 2))];
-	[[fallthrough]]; case 1:++counter[Trait::template get<i>(*(begin - 1))];
-	[[fallthrough]]; case 0:++counter[Trait::template get<i>(*begin)];
-							if (begin == end) [[unlikely]]
-								break;
-		}
-	};
+	indirect_radix_sort_impl<Trait, is_parallel_policy_v<ExecutionPolicy>>(first, second, ctx);
 }
 
-template<size_t i, typename Trait, typename Iter, typename cnt_type>
-void place_duff_device(Iter raw, typename std::iterator_traits<Iter>::value_type* buffer, std::array<cnt_type, std::numeric_limits<unsigned char>::max() + 1 >& counter, size_t pos_beg, size_t pos_end)
+template <typename Trait, typename Iter, typename ExecutionPolicy>
+	requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+void indirect_radix_sort(Iter first, Iter second, ExecutionPolicy&& policy)
 {
-	if constexpr (i % 2 == 0)
-		raw += pos_beg;
-	else
-		buffer += pos_beg;
-	std::ptrdiff_t j_raw = pos_end - pos_beg, j = j_raw - (j_raw % 4);
-	unsigned char t0, t1, t2, t3;
-	if constexpr (i % 2 == 0)
-	{
-		switch (j_raw % 4)
-		{
-			for (; j >= 0; j -= 4)
-			{
-				t3 = Trait::template get<i>(raw[j + 3]);
-				buffer[--counter[t3]] = std::move(raw[j + 3]);
-		[[fallthrough]]; case 3:	t2 = Trait::template get<i>(raw[j + 2]);
-			buffer[--counter[t2]] = std::move(raw[j + 2]);
-		[[fallthrough]]; case 2:	t1 = Trait::template get<i>(raw[j + 1]);
-			buffer[--counter[t1]] = std::move(raw[j + 1]);
-		[[fallthrough]]; case 1:	t0 = Trait::template get<i>(raw[j]);
-			buffer[--counter[t0]] = std::move(raw[j]);
-		[[fallthrough]]; case 0:;
-			}
-		}
-	}
-	else
+	radix_sort_context ctx;
+	indirect_radix_sort_impl<Trait, is_parallel_policy_v<ExecutionPolicy>>(first, second, ctx);
+}
+
+template <typename Iter, typename ExecutionPolicy>
+	requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+void indirect_radix_sort(Iter first, Iter second, ExecutionPolicy&& policy, radix_sort_context& ctx)
+{
+	indirect_radix_sort<radix_trait<typename std::iterator_traits<Iter>::value_type>>(first, second, policy, ctx);
+}
+
+template <typename Iter, typename ExecutionPolicy>
+	requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+void indirect_radix_sort(Iter first, Iter second, ExecutionPolicy&& policy)
+{
+	indirect_radix_sort<radix_trait<typename std::iterator_traits<Iter>::value_type>>(first, second, policy);
+}
+
+template <typename Trait, typename Iter, typename OutIter>
+void indirect_radix_sort_copy(Iter first, Iter second, OutIter d_first, radix_sort_context& ctx)
+{
+	indirect_radix_sort_copy_impl<Trait, false>(first, second, d_first, ctx);
+}
+
+template <typename Trait, typename Iter, typename OutIter>
+void indirect_radix_sort_copy(Iter first, Iter second, OutIter d_first)
+{
+	radix_sort_context ctx;
+	indirect_radix_sort_copy_impl<Trait, false>(first, second, d_first, ctx);
+}
+
+template <typename Iter, typename OutIter>
+void indirect_radix_sort_copy(Iter first, Iter second, OutIter d_first, radix_sort_context& ctx)
+{
+	indirect_radix_sort_copy<radix_trait<typename std::iterator_traits<Iter>::value_type>>(first, second, d_first, ctx);
+}
+
+template <typename Iter, typename OutIter>
+void indirect_radix_sort_copy(Iter first, Iter second, OutIter d_first)
+{
+	indirect_radix_sort_copy<radix_trait<typename std::iterator_traits<Iter>::value_type>>(first, second, d_first);
+}
+
+template <typename Trait, typename Iter, typename OutIter, typename ExecutionPolicy>
+	requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+void indirect_radix_sort_copy(Iter first, Iter second, OutIter d_first, ExecutionPolicy&& policy, radix_sort_context& ctx)
+{
+	indirect_radix_sort_copy_impl<Trait, is_parallel_policy_v<ExecutionPolicy>>(first, second, d_first, ctx);
+}
+
+template <typename Trait, typename Iter, typename OutIter, typename ExecutionPolicy>
+	requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+void indirect_radix_sort_copy(Iter first, Iter second, OutIter d_first, ExecutionPolicy&& policy)
+{
+	radix_sort_context ctx;
+	indirect_radix_sort_copy_impl<Trait, is_parallel_policy_v<ExecutionPolicy>>(first, second, d_first, ctx);
+}
+
+template <typename Iter, typename OutIter, typename ExecutionPolicy>
+	requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+void indirect_radix_sort_copy(Iter first, Iter second, OutIter d_first, ExecutionPolicy&& policy, radix_sort_context& ctx)
+{
+	indirect_radix_sort_copy<radix_trait<typename std::iterator_traits<Iter>::value_type>>(first, second, d_first, policy, ctx);
+}
+
+template <typename Iter, typename OutIter, typename ExecutionPolicy>
+	requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+void indirect_radix_sort_copy(Iter first, Iter second, OutIter d_first, ExecutionPolicy&& policy)
+{
+	indirect_radix_sort_copy<radix_trait<typename std::iterator_traits<Iter>::value_type>>(first, second, d_first, policy);
+}
+
+struct radix_file_closer
+{
+	void operator()(std::FILE* file) const noexcept
 	{
-		switch (j_raw % 4)
-		{
-			for (; j >= 0; j -= 4)
-			{
-				t3 = Trait::template get<i>(buffer[j + 3]);
-				raw[--counter[t3]] = std::move(buffer[j + 3]);
-		[[fallthrough]]; case 3:	t2 = Trait::template get<i>(buffer[j + 2]);
-			raw[--counter[t2]] = std::move(buffer[j + 2]);
-		[[fallthrough]]; case 2:	t1 = Trait::template get<i>(buffer[j + 1]);
-			raw[--counter[t1]] = std::move(buffer[j + 1]);
-		[[fallthrough]]; case 1:	t0 = Trait::template get<i>(buffer[j]);
-			raw[--counter[t0]] = std::move(buffer[j]);
-		[[fallthrough]]; case 0:;
-			}
-		}
+		std::fclose(file);
 	}
+};
+
+using radix_file = std::unique_ptr<std::FILE, radix_file_closer>;
+
+//unbuffered, every transfer of the external sort is a large block already
+inline radix_file radix_open_file(const std::filesystem::path& path, const char* mode)
+{
+	radix_file file(std::fopen(path.string().c_str(), mode));
+	if (!file)
+		throw std::system_error(errno, std::generic_category(), "radix_sort: cannot open " + path.string());
+	std::setvbuf(file.get(), nullptr, _IONBF, 0);
+	return file;
 }
 
-template <size_t i, typename Trait, typename Iter, typename cnt_type>
-void radix_sort_impl(Iter first, Iter second, typename std::iterator_traits<Iter>::value_type* buffer, std::array<cnt_type, std::numeric_limits<unsigned char>::max() + 1 >& counter)
+template <typename T>
+void radix_read_records(std::FILE* file, T* data, size_t n)
 {
-	using namespace std;
-	constexpr auto radix_size = Trait::radix_size;
+	if (std::fread(data, sizeof(T), n, file) != n)
+		throw std::system_error(std::ferror(file) ? errno : EIO, std::generic_category(), "radix_sort: short read");
+}
 
-	if constexpr (i < radix_size)
+template <typename T>
+void radix_write_records(std::FILE* file, const T* data, size_t n)
+{
+	if (std::fwrite(data, sizeof(T), n, file) != n)
+		throw std::system_error(errno, std::generic_category(), "radix_sort: write failed");
+}
+
+//sorts buckets small enough for memory and appends them to out in the order they are pushed.
+//memory holds four slots of capacity records: while the pending bucket is sorted in one slot with another as scratch,
+//the bucket sorted before it is written from the third and the bucket pushed now is read into the fourth
+template <typename Trait, typename T>
+class radix_external_sorter
+{
+public:
+	radix_external_sorter(std::FILE* out, T* memory, size_t capacity, radix_sort_context& ctx) noexcept
+		: out(out), capacity(capacity), ctx(ctx), sorted(memory), pending(memory + capacity), loaded(memory + 2 * capacity), scratch(memory + 3 * capacity)
+	{
+	}
+
+	size_t bucket_limit() const noexcept
 	{
-		count_duff_device<i, Trait>(first, second, counter);
-		for (size_t j = 1; j <= numeric_limits<unsigned char>::max(); ++j)
-			counter[j] += counter[j - 1];
-		place_duff_device<i, Trait>(first, buffer, counter, 0, distance(first, second));
+		return capacity;
 	}
-	if constexpr (i != radix_size - 1)
+
+	//n <= bucket_limit() records of path, which is deleted after it is read when remove is set
+	void push(const std::filesystem::path& path, size_t n, bool remove)
 	{
-		radix_sort_impl<i + 1, Trait, Iter>(first, second, buffer, counter);
+		auto io = std::async(std::launch::async, [&] {
+			radix_write_records(out, sorted, sorted_num);
+			auto in = radix_open_file(path, "rb");
+			radix_read_records(in.get(), loaded, n);
+			in.reset();
+			if (remove)
+				std::filesystem::remove(path);
+		});
+		parallel_radix_sort<Trait>(pending, pending + pending_num, scratch, ctx);
+		io.get();
+		std::swap(sorted, pending);
+		std::swap(pending, loaded);
+		sorted_num = pending_num;
+		pending_num = n;
 	}
-	else if constexpr (radix_size % 2)
+
+	//write everything pushed so far, after this the memory may be used for something else
+	void flush()
 	{
-		std::move(buffer, buffer + std::distance(first, second), first);
+		auto io = std::async(std::launch::async, [&] {
+			radix_write_records(out, sorted, sorted_num);
+		});
+		parallel_radix_sort<Trait>(pending, pending + pending_num, scratch, ctx);
+		io.get();
+		radix_write_records(out, pending, pending_num);
+		sorted_num = pending_num = 0;
 	}
-}
 
-template <size_t i, typename Iter, typename Trait, typename cnt_type>
-void parallel_radix_sort_impl(Iter first, Iter second, unsigned int thrd_lim, typename std::iterator_traits<Iter>::value_type* buffer, std::array<cnt_type, std::numeric_limits<unsigned char>::max() + 1 >* counter)
-{
-	using namespace std;
-	constexpr auto radix_size = Trait::radix_size;
-	auto length = distance(first, second), parallel_width = length / thrd_lim;
-	if constexpr (i < radix_size)
+	//copy records of path to out as they are, for a bucket whose keys are all equal
+	void append(const std::filesystem::path& path, size_t n, T* memory, size_t memory_size)
 	{
+		flush();
+		auto in = radix_open_file(path, "rb");
+		for (size_t pos = 0; pos < n; pos += memory_size)
 		{
-			vector<future<void>> wait_works;
-			wait_works.reserve(thrd_lim - 1);
-			auto j = 0u;
-			for (; j < thrd_lim - 1; ++j)
-			{
-				auto beg = j * parallel_width, end = beg + parallel_width;
-				if constexpr (i % 2 == 0)
-					wait_works.emplace_back(async(launch::async, count_duff_device<i, Trait, Iter, cnt_type>, first + beg, first + end, std::ref(counter[j])));
-				else
-					wait_works.emplace_back(async(launch::async, count_duff_device<i, Trait, typename std::iterator_traits<Iter>::value_type*, cnt_type>, buffer + beg, buffer + end, std::ref(counter[j])));
-			}
-			auto beg = j * parallel_width;
-			if constexpr (i % 2 == 0)
-				count_duff_device<i, Trait>(first + beg, first + length, counter[j]);
-			else
-				count_duff_device<i, Trait>(buffer + beg, buffer + length, counter[j]);
+			auto len = std::min(memory_size, n - pos);
+			radix_read_records(in.get(), memory, len);
+			radix_write_records(out, memory, len);
 		}
+	}
 
-		for (int j = thrd_lim - 2; j >= 0; --j)
-			for (size_t k = 0; k <= numeric_limits<unsigned char>::max(); ++k)
-				counter[j][k] += counter[j + 1][k];
-		for (size_t j = 1; j <= numeric_limits<unsigned char>::max(); ++j)
-			counter[0][j] += counter[0][j - 1];
-		for (auto j = 1u; j < thrd_lim; ++j)
-			for (size_t k = 0; k <= numeric_limits<unsigned char>::max(); ++k)
-				counter[j][k] = counter[0][k] - counter[j][k];
+private:
+	std::FILE* out;
+	size_t capacity;
+	radix_sort_context& ctx;
+	T* sorted;
+	T* pending;
+	T* loaded;
+	T* scratch;
+	size_t sorted_num = 0, pending_num = 0;
+};
 
-		vector<future<void>> wait_works;
-		wait_works.reserve(thrd_lim - 1);
-		auto j = 0u;
-		for (; j < thrd_lim - 1; ++j)
+//split the length records of path by digit i into dir/0, dir/1, ..., keeping their order, and return the bucket sizes.
+//the next chunk of input is read on another thread while the current one is distributed into per-bucket stages
+template <size_t i, typename Trait, typename T>
+std::array<size_t, radix_bucket_num_v<Trait>> radix_external_partition(const std::filesystem::path& path, size_t length, const std::filesystem::path& dir, T* memory, size_t memory_size)
+{
+	using namespace std;
+	constexpr auto bucket_num = radix_bucket_num_v<Trait>;
+	auto chunk_size = memory_size / 4;
+	auto stage_size = (memory_size - 2 * chunk_size) / bucket_num;
+	T* chunk[2] = { memory, memory + chunk_size };
+	T* stage = memory + 2 * chunk_size;
+	array<size_t, bucket_num> fill{}, count{};
+	array<radix_file, bucket_num> bucket;
+	auto flush_bucket = [&](size_t b) {
+		if (!bucket[b])
+			bucket[b] = radix_open_file(dir / to_string(b), "wb");
+		radix_write_records(bucket[b].get(), stage + b * stage_size, fill[b]);
+		count[b] += fill[b];
+		fill[b] = 0;
+	};
+	create_directories(dir);
+	auto in = radix_open_file(path, "rb");
+	auto len = min(chunk_size, length);
+	radix_read_records(in.get(), chunk[0], len);
+	for (size_t pos = 0, cur = 0; pos < length; cur ^= 1)
+	{
+		pos += len;
+		auto next_len = min(chunk_size, length - pos);
+		auto io = async(launch::async, [&, cur] {
+			radix_read_records(in.get(), chunk[cur ^ 1], next_len);
+		});
+		for (size_t k = 0; k < len; ++k)
 		{
-			auto beg = j * parallel_width, end = beg + parallel_width;
-			wait_works.emplace_back(async(launch::async, place_duff_device<i, Trait, Iter, cnt_type>, first, buffer, ref(counter[j + 1]), beg, end));
+			size_t b = Trait::template get<i>(chunk[cur][k]);
+			stage[b * stage_size + fill[b]++] = chunk[cur][k];
+			if (fill[b] == stage_size)
+				flush_bucket(b);
 		}
-		place_duff_device<i, Trait>(first, buffer, counter[0], j * parallel_width, length);
-	}
-	if constexpr (i != radix_size - 1)
-	{
-		parallel_radix_sort_impl<i + 1, Iter, Trait>(first, second, thrd_lim, buffer, counter);
-	}
-	else if constexpr (radix_size % 2)
-	{
-		std::move(buffer, buffer + length, first);
+		io.get();
+		len = next_len;
 	}
+	for (size_t b = 0; b < bucket_num; ++b)
+		if (fill[b] > 0)
+			flush_bucket(b);
+	return count;
 }
 
-template <typename Trait, typename Iter>
-void parallel_radix_sort(Iter first, Iter second, typename std::iterator_traits<Iter>::value_type* buffer = nullptr, unsigned int thrd_lim = std::thread::hardware_concurrency())
+//sort the length records of path, whose digits above i are all equal, onto the sorter's output.
+//buckets still too large for memory are partitioned again by the next digit, so skewed input only costs extra passes where it is skewed
+template <size_t i, typename Trait, typename T>
+void radix_external_sort_file(const std::filesystem::path& path, size_t length, const std::filesystem::path& dir, radix_external_sorter<Trait, T>& sorter, T* memory, size_t memory_size, bool remove)
 {
 	using namespace std;
-	using value_type = typename iterator_traits<Iter>::value_type;
-	constexpr auto thrd_sort_length_limit = 100000; //each thread's min sort length
-	auto length = distance(first, second);
-	thrd_lim = min<decltype(length)>(thrd_lim, max<decltype(length)>(1u, length / thrd_sort_length_limit));
-	unique_ptr<unsigned char[]> resource;
-	if (buffer == nullptr)
-	{
-		resource = make_unique<unsigned char[]>(length * sizeof(value_type));
-		buffer = (value_type*)resource.get();
-	}
-	if (thrd_lim > 1)
+	if (length <= sorter.bucket_limit())
 	{
-		//cnt type optimize seems negative in multi-thread?
-		auto counter = make_unique<array<decltype(length), numeric_limits<unsigned char>::max() + 1 >[]>(thrd_lim);
-		parallel_radix_sort_impl<0, Iter, Trait>(first, second, thrd_lim, buffer, counter.get());
-
+		sorter.push(path, length, remove);
+		return;
 	}
-	else
+	sorter.flush();
+	auto count = radix_external_partition<i, Trait>(path, length, dir, memory, memory_size);
+	if (remove)
+		filesystem::remove(path);
+	for (size_t b = 0; b < count.size(); ++b)
 	{
-		if (length <= INT_MAX) //int is enough for counter
-		{
-			auto counter = make_unique<array<int, numeric_limits<unsigned char>::max() + 1 >>();
-			radix_sort_impl<0, Trait, Iter>(first, second, buffer, *counter);
-		}
+		if (count[b] == 0)
+			continue;
+		auto bucket = dir / to_string(b);
+		if constexpr (i > 0)
+			radix_external_sort_file<i - 1, Trait>(bucket, count[b], dir / (to_string(b) + ".d"), sorter, memory, memory_size, true);
 		else
 		{
-			auto counter = make_unique<array<decltype(length), numeric_limits<unsigned char>::max() + 1 >>();
-			radix_sort_impl<0, Trait, Iter>(first, second, buffer, *counter);
+			sorter.append(bucket, count[b], memory, memory_size);
+			filesystem::remove(bucket);
 		}
 	}
 }
 
-template <typename Iter>
-void parallel_radix_sort(Iter first, Iter second, typename std::iterator_traits<Iter>::value_type* buffer = nullptr, unsigned int thrd_lim = std::thread::hardware_concurrency())
-{
-	parallel_radix_sort<radix_trait<typename std::iterator_traits<Iter>::value_type>>(first, second, buffer, thrd_lim);
-}
-
-template <typename Trait, typename Iter>
-void radix_sort(Iter first, Iter second, typename std::iterator_traits<Iter>::value_type* buffer = nullptr)
+//sort a binary file of T records into output_path using about memory_budget bytes (at least 1024 records).
+//the input is partitioned by its top digit into bucket files in a directory beside the output, then every bucket is
+//sorted in memory with parallel_radix_sort while its neighbours are read and written. output_path may be input_path
+template <typename T, typename Trait = radix_trait<T>>
+void external_radix_sort(const std::filesystem::path& input_path, const std::filesystem::path& output_path, size_t memory_budget, radix_sort_context& ctx)
 {
 	using namespace std;
-	using value_type = typename iterator_traits<Iter>::value_type;
-	auto length = distance(first, second);
-	unique_ptr<unsigned char[]> resource;
-	if (buffer == nullptr)
+	static_assert(is_trivially_copy_constructible_v<T> && is_trivially_destructible_v<T>, "records are read and written as raw bytes");
+	static_assert(radix_digit_bits_v<Trait> <= 8, "every bucket of a partition pass is an open file");
+	auto bytes = filesystem::file_size(input_path);
+	if (bytes % sizeof(T) != 0)
+		throw invalid_argument("radix_sort: " + input_path.string() + " is not a whole number of records");
+	auto length = bytes / sizeof(T);
+	auto memory_size = max<size_t>(memory_budget / sizeof(T), 1024);
+	auto memory = ctx.buffer<T>(memory_size);
+	//a new directory beside the output keeps the final rename on one file system, an existing path is never touched
+	filesystem::path dir;
+	for (random_device rd;;)
 	{
-		resource = make_unique<unsigned char[]>(length * sizeof(value_type));
-		buffer = (value_type*)resource.get();
+		dir = output_path;
+		dir += ".radix_sort." + to_string(rd()) + ".tmp";
+		if (!filesystem::exists(dir) && filesystem::create_directory(dir))
+			break;
 	}
-	if (length <= INT_MAX) //int is enough for counter 
+	try
 	{
-		auto counter = make_unique<array<int, numeric_limits<unsigned char>::max() + 1 >>();
-		radix_sort_impl<0, Trait, Iter>(first, second, buffer, *counter);
+		auto out_path = dir / "out";
+		auto out = radix_open_file(out_path, "wb");
+		radix_external_sorter<Trait, T> sorter(out.get(), memory, memory_size / 4, ctx);
+		radix_external_sort_file<Trait::radix_size - 1, Trait>(input_path, length, dir / "d", sorter, memory, memory_size, false);
+		sorter.flush();
+		out.reset();
+		filesystem::rename(out_path, output_path);
 	}
-	else
+	catch (...)
 	{
-		auto counter = make_unique<array<decltype(length), numeric_limits<unsigned char>::max() + 1 >>();
-		radix_sort_impl<0, Trait, Iter>(first, second, buffer, *counter);
+		filesystem::remove_all(dir);
+		throw;
 	}
+	filesystem::remove_all(dir);
 }
 
-template <typename Iter>
-void radix_sort(Iter first, Iter second, typename std::iterator_traits<Iter>::value_type* buffer = nullptr)
-{
-	radix_sort<radix_trait<typename std::iterator_traits<Iter>::value_type>>(first, second, buffer);
-}
-
-template <typename Iter, typename ExecutionPolicy>
-void radix_sort(Iter first, Iter second, ExecutionPolicy&& policy, typename std::iterator_traits<Iter>::value_type* buffer = nullptr)
-{
-	if constexpr (std::is_same_v<std::remove_cvref_t<ExecutionPolicy>, std::execution::parallel_policy> || std::is_same_v<std::remove_cvref_t<ExecutionPolicy>, std::execution::parallel_unsequenced_policy>)
-		parallel_radix_sort<radix_trait<typename std::iterator_traits<Iter>::value_type>>(first, second, buffer);
-	else
-		radix_sort<radix_trait<typename std::iterator_traits<Iter>::value_type>>(first, second, buffer);
-}
-
-template <typename Trait, typename Iter, typename ExecutionPolicy>
-void radix_sort(Iter first, Iter second, ExecutionPolicy&& policy, typename std::iterator_traits<Iter>::value_type* buffer = nullptr)
+template <typename T, typename Trait = radix_trait<T>>
+void external_radix_sort(const std::filesystem::path& input_path, const std::filesystem::path& output_path, size_t memory_budget)
 {
-	if constexpr (std::is_same_v<std::remove_cvref_t<ExecutionPolicy>, std::execution::parallel_policy> || std::is_same_v<std::remove_cvref_t<ExecutionPolicy>, std::execution::parallel_unsequenced_policy>)
-		parallel_radix_sort<Trait>(first, second, buffer);
-	else
-		radix_sort<Trait>(first, second, buffer);
+	radix_sort_context ctx;
+	external_radix_sort<T, Trait>(input_path, output_path, memory_budget, ctx);
 }
 
-
-template <typename T>
-struct radix_trait<T*>
+template <typename T, size_t bits>
+struct radix_trait<T*, bits>
 {
-	static constexpr std::size_t radix_size = sizeof(T*) / sizeof(unsigned char);
+	static constexpr std::size_t digit_bits = bits;
+	static constexpr std::size_t radix_size = radix_digit_num_v<sizeof(T*), bits>;
 	template <size_t index>
-	static unsigned char get(T* const & obj) noexcept
+	static radix_digit_t<bits> get(T* const & obj) noexcept
 	{
 		static_assert(index < radix_size);
-		return ((unsigned char*)&obj)[index];
+		if constexpr (bits == CHAR_BIT)
+			return ((unsigned char*)&obj)[index];
+		else
+			return radix_extract<index, bits>(radix_key_bits(obj));
 	}
 };
 
-template <typename T>
-struct radix_trait_greater<T*>
+template <typename T, size_t bits>
+struct radix_trait_greater<T*, bits>
 {
-	static constexpr std::size_t radix_size = sizeof(T) / sizeof(unsigned char);
+	static constexpr std::size_t digit_bits = bits;
+	static constexpr std::size_t radix_size = radix_digit_num_v<sizeof(T*), bits>;
 	template <size_t index>
-	static unsigned char get(T* const& obj) noexcept
+	static radix_digit_t<bits> get(T* const& obj) noexcept
 	{
-		static_assert(index < radix_size);
-		return ~((unsigned char*)&obj)[index];
+		return radix_trait<T*, bits>::template get<index>(obj) ^ ((1u << bits) - 1);
 	}
 };
 
-template <std::unsigned_integral T>
-struct radix_trait<T>
+template <std::unsigned_integral T, size_t bits>
+struct radix_trait<T, bits>
 {
-	static constexpr std::size_t radix_size = sizeof(T) / sizeof(unsigned char);
+	static constexpr std::size_t digit_bits = bits;
+	static constexpr std::size_t radix_size = radix_digit_num_v<sizeof(T), bits>;
 	template <size_t index>
-	static unsigned char get(const T& obj) noexcept
+	static radix_digit_t<bits> get(const T& obj) noexcept
 	{
 		static_assert(index < radix_size);
-		return ((unsigned char*)&obj)[index];
+		if constexpr (bits == CHAR_BIT)
+			return ((unsigned char*)&obj)[index];
+		else
+			return radix_extract<index, bits>(radix_key_bits(obj));
 	}
 };
 
-template <std::unsigned_integral T>
-struct radix_trait_greater<T>
+template <std::unsigned_integral T, size_t bits>
+struct radix_trait_greater<T, bits>
 {
-	static constexpr std::size_t radix_size = sizeof(T) / sizeof(unsigned char);
+	static constexpr std::size_t digit_bits = bits;
+	static constexpr std::size_t radix_size = radix_digit_num_v<sizeof(T), bits>;
 	template <size_t index>
-	static unsigned char get(const T& obj) noexcept
+	static radix_digit_t<bits> get(const T& obj) noexcept
 	{
-		static_assert(index < radix_size);
-		return ~((unsigned char*)&obj)[index];
+		return radix_trait<T, bits>::template get<index>(obj) ^ ((1u << bits) - 1);
 	}
 };
 
 
-template <typename T>
-	requires std::signed_integral<T> || std::floating_point<T>
-struct radix_trait<T>
+template <std::signed_integral T, size_t bits>
+struct radix_trait<T, bits>
 {
-	static constexpr std::size_t radix_size = sizeof(T) / sizeof(unsigned char);
+	static constexpr std::size_t digit_bits = bits;
+	static constexpr std::size_t radix_size = radix_digit_num_v<sizeof(T), bits>;
 	template <size_t index>
-	static unsigned char get(const T& obj) noexcept
+	static radix_digit_t<bits> get(const T& obj) noexcept
 	{
 		static_assert(index < radix_size);
-		if constexpr (index < radix_size - 1)
+		if constexpr (bits != CHAR_BIT)
+			return radix_extract<index, bits>(radix_key_bits(obj) ^ (std::uint64_t(1) << (sizeof(T) * CHAR_BIT - 1)));
+		else if constexpr (index < radix_size - 1)
 			return ((unsigned char*)&obj)[index];
 		else
 			return ((unsigned char*)&obj)[index] ^ 0x80u;
 	}
 };
 
-template <typename T>
+template <typename T, size_t bits>
 	requires std::signed_integral<T> || std::floating_point<T>
-struct radix_trait_greater<T>
+struct radix_trait_greater<T, bits>
+{
+	static constexpr std::size_t digit_bits = bits;
+	static constexpr std::size_t radix_size = radix_digit_num_v<sizeof(T), bits>;
+	template <size_t index>
+	static radix_digit_t<bits> get(const T& obj) noexcept
+	{
+		return radix_trait<T, bits>::template get<index>(obj) ^ ((1u << bits) - 1);
+	}
+};
+
+//the sign bit flipped for positive floats, every bit for negative ones. NaNs with the sign bit set come first, the rest last
+template <std::floating_point T, size_t bits>
+	requires (sizeof(T) <= sizeof(std::uint64_t))
+struct radix_trait<T, bits>
+{
+	static constexpr std::size_t digit_bits = bits;
+	static constexpr std::size_t radix_size = radix_digit_num_v<sizeof(T), bits>;
+	template <size_t index>
+	static radix_digit_t<bits> get(const T& obj) noexcept
+	{
+		static_assert(index < radix_size);
+		if constexpr (bits != CHAR_BIT)
+		{
+			auto key = radix_key_bits(obj);
+			return radix_extract<index, bits>(key ^ radix_magnitude_mask<T>(key) ^ (std::uint64_t(1) << (sizeof(T) * CHAR_BIT - 1)));
+		}
+		else
+		{
+			//0xff for negative floats, from the sign of the top byte
+			auto flip = static_cast<unsigned char>(((signed char*)&obj)[sizeof(T) - 1] >> 7);
+			if constexpr (index < radix_size - 1)
+				return ((unsigned char*)&obj)[index] ^ flip;
+			else
+				return ((unsigned char*)&obj)[index] ^ (flip | 0x80u);
+		}
+	}
+};
+
+template <typename CharT, typename Traits, typename Alloc, size_t bits>
+	requires (sizeof(CharT) == 1)
+struct radix_trait<std::basic_string<CharT, Traits, Alloc>, bits>
 {
-	static constexpr std::size_t radix_size = sizeof(T) / sizeof(unsigned char);
+	static std::span<const unsigned char> key(const std::basic_string<CharT, Traits, Alloc>& obj) noexcept
+	{
+		return { reinterpret_cast<const unsigned char*>(obj.data()), obj.size() };
+	}
+};
+
+template <typename CharT, typename Traits, size_t bits>
+	requires (sizeof(CharT) == 1)
+struct radix_trait<std::basic_string_view<CharT, Traits>, bits>
+{
+	static std::span<const unsigned char> key(const std::basic_string_view<CharT, Traits>& obj) noexcept
+	{
+		return { reinterpret_cast<const unsigned char*>(obj.data()), obj.size() };
+	}
+};
+
+template <typename B, size_t extent, size_t bits>
+	requires (sizeof(B) == 1 && !std::is_same_v<std::remove_cv_t<B>, bool>)
+struct radix_trait<std::span<B, extent>, bits>
+{
+	static std::span<const unsigned char> key(const std::span<B, extent>& obj) noexcept
+	{
+		return { reinterpret_cast<const unsigned char*>(obj.data()), obj.size() };
+	}
+};
+
+template<typename p1, typename p2, size_t bits>
+struct radix_trait<std::pair<p1, p2>, bits>
+{
+	static constexpr std::size_t digit_bits = bits;
+	static constexpr std::size_t radix_size = radix_trait<p1, bits>::radix_size + radix_trait<p2, bits>::radix_size;
 	template <size_t index>
-	static unsigned char get(const T& obj) noexcept
+	static radix_digit_t<bits> get(const std::pair<p1, p2>& obj) noexcept
 	{
 		static_assert(index < radix_size);
-		if constexpr (index < radix_size - 1)
-			return ~((unsigned char*)&obj)[index];
+		if constexpr (index < radix_trait<p2, bits>::radix_size)
+			return radix_trait<p2, bits>::template get<index>(obj.second);
+		else
+			return radix_trait<p1, bits>::template get<index - radix_trait<p2, bits>::radix_size>(obj.first);
+	}
+};
+
+enum class radix_order
+{
+	ascending,
+	descending
+};
+
+//one field of a composite key: selector is a data member pointer, or an index for std::get of tuples and arrays.
+//a declared range [min,max] of an integer or enum field stores value - min in bit_width(max - min) bits,
+//values outside it sort in no particular order
+template <auto selector, radix_order order = radix_order::ascending, auto min = nullptr, auto max = nullptr>
+struct radix_field
+{
+	static constexpr bool ranged = !std::is_null_pointer_v<decltype(min)>;
+	static_assert(ranged == !std::is_null_pointer_v<decltype(max)>, "declare both ends of a range");
+
+	template <typename T>
+	static const auto& value(const T& obj) noexcept
+	{
+		if constexpr (std::is_member_object_pointer_v<decltype(selector)>)
+			return obj.*selector;
+		else
+			return std::get<selector>(obj);
+	}
+
+	template <typename T>
+	using value_type = std::remove_cvref_t<decltype(value(std::declval<const T&>()))>;
+
+	//an integer or enum widened to 64 bits, differences of two are exact modulo 2^64
+	template <typename V>
+	static constexpr std::uint64_t integer(const V& v) noexcept
+	{
+		if constexpr (std::is_enum_v<V>)
+			return integer(static_cast<std::underlying_type_t<V>>(v));
+		else if constexpr (std::is_signed_v<V>)
+			return static_cast<std::uint64_t>(static_cast<std::int64_t>(v));
+		else
+			return static_cast<std::uint64_t>(v);
+	}
+
+	//key bits of the field, fewer for a range or a bool
+	template <typename T>
+	static constexpr size_t bits() noexcept
+	{
+		using V = value_type<T>;
+		static_assert((std::is_arithmetic_v<V> || std::is_enum_v<V> || std::is_pointer_v<V>) && sizeof(V) <= sizeof(std::uint64_t), "fields are scalars");
+		if constexpr (ranged)
+		{
+			static_assert(std::is_integral_v<V> || std::is_enum_v<V>, "ranges are declared for integer and enum fields");
+			static_assert(!(static_cast<V>(max) < static_cast<V>(min)), "min must not exceed max");
+			return std::max<size_t>(std::bit_width(integer(static_cast<V>(max)) - integer(static_cast<V>(min))), 1);
+		}
+		else if constexpr (std::is_same_v<V, bool>)
+			return 1;
+		else
+			return sizeof(V) * CHAR_BIT;
+	}
+
+	//the field as an unsigned integer of bits<T>() bits that orders like the field
+	template <typename T>
+	static std::uint64_t key(const T& obj) noexcept
+	{
+		using V = value_type<T>;
+		constexpr auto mask = ~std::uint64_t(0) >> (64 - bits<T>());
+		auto& v = value(obj);
+		std::uint64_t k;
+		if constexpr (ranged)
+			k = integer(v) - integer(static_cast<V>(min));
+		else if constexpr (std::is_same_v<V, bool>)
+			k = v;
+		else if constexpr (std::is_enum_v<V>)
+			k = integer(v) ^ (std::is_signed_v<std::underlying_type_t<V>> ? std::uint64_t(1) << (bits<T>() - 1) : 0);
 		else
-			return ~(((unsigned char*)&obj)[index] ^ 0x80u);
+			k = radix_key_bits(v) ^ radix_magnitude_mask<V>(radix_key_bits(v)) ^ (std::is_signed_v<V> ? std::uint64_t(1) << (bits<T>() - 1) : 0);
+		if constexpr (order == radix_order::descending)
+			k = ~k;
+		return k & mask;
 	}
 };
 
-template<typename p1, typename p2>
-struct radix_trait<std::pair<p1, p2>>
+//trait of T sorted by Fields, the first one most significant. the field keys are packed back to back at compile time,
+//so radix_size only covers bits that can differ: no padding, no bytes beyond a declared range, one bit per bool
+template <typename T, size_t bits, typename... Fields>
+struct radix_composite_trait
 {
-	static constexpr std::size_t radix_size = (sizeof(p1)+sizeof(p2)) / sizeof(unsigned char);
+	static constexpr std::size_t digit_bits = bits;
+	static constexpr std::array<size_t, sizeof...(Fields)> field_bits{ Fields::template bits<T>()... };
+	static constexpr size_t key_bits = (Fields::template bits<T>() + ... + 0);
+	static constexpr std::size_t radix_size = (key_bits + bits - 1) / bits;
+	static_assert(key_bits > 0, "a composite key needs at least one field");
+
 	template <size_t index>
-	static unsigned char get(const std::pair<p1, p2>& obj) noexcept
+	static radix_digit_t<bits> get(const T& obj) noexcept
 	{
 		static_assert(index < radix_size);
-		if constexpr (index < sizeof(p2))
-			return radix_trait<p2>::template get<index>(obj.second);
+		return static_cast<radix_digit_t<bits>>(get_digit<index>(obj, std::index_sequence_for<Fields...>{}));
+	}
+
+private:
+	//lowest key bit of field f, the later fields sit below it
+	static constexpr size_t field_offset(size_t f) noexcept
+	{
+		size_t offset = 0;
+		for (auto g = f + 1; g < field_bits.size(); ++g)
+			offset += field_bits[g];
+		return offset;
+	}
+
+	template <size_t index, size_t... f>
+	static std::uint64_t get_digit(const T& obj, std::index_sequence<f...>) noexcept
+	{
+		return (field_digit<index, f>(obj) | ...);
+	}
+
+	//the part of digit index that field f covers, fields outside the digit are not read
+	template <size_t index, size_t f>
+	static std::uint64_t field_digit(const T& obj) noexcept
+	{
+		constexpr auto digit_beg = index * bits, field_beg = field_offset(f), field_end = field_beg + field_bits[f];
+		if constexpr (field_end <= digit_beg || field_beg >= digit_beg + bits)
+			return 0;
 		else
-			return radix_trait<p1>::template get<index - sizeof(p2)>(obj.first);
+		{
+			constexpr auto digit_mask = (std::uint64_t(1) << bits) - 1;
+			auto k = std::tuple_element_t<f, std::tuple<Fields...>>::key(obj);
+			if constexpr (field_beg >= digit_beg)
+				return (k << (field_beg - digit_beg)) & digit_mask;
+			else
+				return (k >> (digit_beg - field_beg)) & digit_mask;
+		}
 	}
 };
+
+template <typename T, typename... Fields>
+using radix_key_trait = radix_composite_trait<T, CHAR_BIT, Fields...>;
+
+template <typename T, size_t bits, typename Seq>
+struct radix_indexed_trait;
+
+//every element of a tuple or array ascending, the first one most significant
+template <typename T, size_t bits, size_t... i>
+struct radix_indexed_trait<T, bits, std::index_sequence<i...>>
+{
+	using type = radix_composite_trait<T, bits, radix_field<i>...>;
+};
+
+template <typename... Ts, size_t bits>
+struct radix_trait<std::tuple<Ts...>, bits> : radix_indexed_trait<std::tuple<Ts...>, bits, std::index_sequence_for<Ts...>>::type
+{
+};
+
+template <typename T, size_t n, size_t bits>
+	requires (n > 0)
+struct radix_trait<std::array<T, n>, bits> : radix_indexed_trait<std::array<T, n>, bits, std::make_index_sequence<n>>::type
+{
+};
@@ -0,0 +1,112 @@
+#include "../include/radix_sort.hpp"
+#include <iostream>
+#include <fstream>
+#include <random>
+
+//external_radix_sort on temp files of the local disk, every result is compared with std::sort of the same records
+
+int failures = 0;
+
+void check(bool ok, const std::string& what)
+{
+	if (!ok)
+	{
+		std::cerr << "FAILED: " << what << std::endl;
+		++failures;
+	}
+}
+
+template <typename T>
+void write_file(const std::filesystem::path& path, const std::vector<T>& ar)
+{
+	std::ofstream(path, std::ios::binary).write(reinterpret_cast<const char*>(ar.data()), ar.size() * sizeof(T));
+}
+
+template <typename T>
+std::vector<T> read_file(const std::filesystem::path& path)
+{
+	std::vector<T> ar(std::filesystem::file_size(path) / sizeof(T));
+	std::ifstream(path, std::ios::binary).read(reinterpret_cast<char*>(ar.data()), ar.size() * sizeof(T));
+	return ar;
+}
+
+//sort ar through input into output, or in place when output is input
+template <typename T>
+void test_sort(const std::string& name, const std::vector<T>& ar, size_t memory_budget, const std::filesystem::path& input, const std::filesystem::path& output)
+{
+	using namespace std;
+	write_file(input, ar);
+	external_radix_sort<T>(input, output, memory_budget);
+	auto expected = ar;
+	sort(expected.begin(), expected.end());
+	check(read_file<T>(output) == expected, name);
+	if (output != input)
+		check(read_file<T>(input) == ar, name + ": input unchanged");
+	auto prefix = output.filename().string() + ".radix_sort.";
+	for (auto& entry : filesystem::directory_iterator(output.parent_path()))
+		check(!entry.path().filename().string().starts_with(prefix), name + ": temp directory removed");
+}
+
+int main()
+{
+	using namespace std;
+	auto dir = filesystem::temp_directory_path() / ("radix_sort_test_" + to_string(random_device{}()));
+	filesystem::create_directories(dir);
+	auto input = dir / "in.bin", output = dir / "out.bin";
+	try
+	{
+		mt19937_64 e(114514);
+		vector<size_t> uniform(200000);
+		for (auto& x : uniform)
+			x = e();
+		//one pass: every bucket of the top digit fits in memory
+		test_sort("uniform, large budget", uniform, size_t(1) << 24, input, output);
+		//buckets larger than the budget are partitioned again by the next digits
+		test_sort("uniform, 8KB budget", uniform, 8192, input, output);
+
+		vector<size_t> skewed(uniform.size());
+		for (size_t k = 0; k < skewed.size(); ++k)
+			skewed[k] = k % 7 == 0 ? uniform[k] : uniform[k] % 1000;
+		test_sort("skewed, 8KB budget", skewed, 8192, input, output);
+
+		vector<int> negative(100000);
+		for (auto& x : negative)
+			x = static_cast<int>(e() % 2001) - 1000;
+		test_sort("int with duplicates", negative, 8192, input, output);
+
+		test_sort("empty file", vector<size_t>{}, 8192, input, output);
+
+		//a path beside the output that only looks like a temp directory belongs to the user
+		auto user_file = output;
+		user_file += ".radix_sort.tmp";
+		ofstream(user_file) << "keep";
+		write_file(input, uniform);
+		external_radix_sort<size_t>(input, output, 8192);
+		check(filesystem::exists(user_file) && filesystem::file_size(user_file) == 4, "existing files beside the output are kept");
+		filesystem::remove(user_file);
+
+		test_sort("output_path == input_path", uniform, 8192, input, input);
+
+		{
+			ofstream(input, ios::binary).write("0123456789", 10);
+			bool thrown = false;
+			try
+			{
+				external_radix_sort<size_t>(input, output, 8192);
+			}
+			catch (const invalid_argument&)
+			{
+				thrown = true;
+			}
+			check(thrown, "a partial record throws invalid_argument");
+		}
+	}
+	catch (const exception& ex)
+	{
+		check(false, string("exception: ") + ex.what());
+	}
+	filesystem::remove_all(dir);
+	if (failures == 0)
+		cout << "external_radix_sort: all tests passed" << endl;
+	return failures == 0 ? 0 : 1;
+}